@@ -0,0 +1,57 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+sql_file="${1}"
+exe="${2}"
+expect="${3}" # "ok" or "fail"
+
+if [[ "$expect" = "ok" ]]; then
+    # Feed all semicolon-terminated statements through stdin in one process;
+    # every one of them must be accepted and counted.
+    statements="$(grep -v '^--' "${sql_file}" | grep ';$')"
+    count="$(printf '%s\n' "$statements" | wc -l)"
+
+    output="$(printf '%s\n' "$statements" | "${exe}" --file -)" || {
+        echo "UNEXPECTED FAIL in batch:" >&2
+        grep -A2 'validation failed' <<< "$output" >&2
+        exit 1
+    }
+    tail -n 1 <<< "$output" | grep -q "^total: ${count} statements, ${count} ok, 0 failed$" || {
+        echo "UNEXPECTED TOTAL: $(tail -n 1 <<< "$output")" >&2
+        exit 1
+    }
+else
+    # The whole file (including comment lines) is read with --file; at least
+    # one statement must be rejected.
+    if "${exe}" --file "${sql_file}" >/dev/null 2>&1; then
+        echo "UNEXPECTED PASS: ${sql_file}" >&2
+        exit 1
+    fi
+fi
+
+# --stream reads the same file in chunks and must reach the same verdicts.
+file_total="$("${exe}" --file "${sql_file}" | tail -n 1)" || true
+stream_total="$("${exe}" --stream < "${sql_file}" | tail -n 1)" || true
+if [[ "$file_total" != "$stream_total" ]]; then
+    echo "STREAM MISMATCH: '${stream_total}' vs '${file_total}'" >&2
+    exit 1
+fi
+
+# --jobs spreads the statements over threads; the output must not change.
+if ! cmp -s <("${exe}" --file "${sql_file}" || true) \
+            <("${exe}" --file "${sql_file}" --jobs 4 || true); then
+    echo "PARALLEL OUTPUT DIFFERS: ${sql_file}" >&2
+    exit 1
+fi
+
+# --format=jsonl prints one record per statement with the same verdicts.
+jsonl_total="$("${exe}" --file "${sql_file}" --format=jsonl | python3 -c '
+import json, sys
+rows = [json.loads(line) for line in sys.stdin]
+ok = sum(1 for r in rows if r["ok"])
+print(f"total: {len(rows)} statements, {ok} ok, {len(rows) - ok} failed")
+')" || true
+if [[ "$file_total" != "$jsonl_total" ]]; then
+    echo "JSONL MISMATCH: '${jsonl_total}' vs '${file_total}'" >&2
+    exit 1
+fi
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""Compile the validator grammar into a dense DFA transition table.
+
+Usage: gen-grammar.py <grammar.txt> <grammar.h>
+
+Every line of the grammar names a state and the tokens it accepts; see the
+header of src/grammar.txt. The output defines the GrammarState enum
+(STATE_ERROR is 0, so every cell the grammar does not mention rejects the
+token), GRAMMAR_START and grammar_next[state][token], indexed by SqlSymbols
+values.
+"""
+
+import re
+import sys
+
+NAME = re.compile(r"[A-Z_]+")
+
+
+def parse(path):
+    states = {}
+    with open(path, encoding="utf-8") as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.split("#", 1)[0].split()
+            if not line:
+                continue
+            state, edges = line[0], []
+            if not NAME.fullmatch(state):
+                sys.exit(f"{path}:{lineno}: bad state name {state}")
+            if state in states:
+                sys.exit(f"{path}:{lineno}: state {state} defined twice")
+            for item in line[1:]:
+                token, _, target = item.partition("=")
+                target = target or token
+                if not NAME.fullmatch(token) or not NAME.fullmatch(target):
+                    sys.exit(f"{path}:{lineno}: bad transition {item}")
+                if token in (t for t, _ in edges):
+                    sys.exit(f"{path}:{lineno}: {token} listed twice")
+                edges.append((token, target))
+            states[state] = (lineno, edges)
+
+    if not states:
+        sys.exit(f"{path}: no states")
+    for state, (lineno, edges) in states.items():
+        for _, target in edges:
+            if target not in states:
+                sys.exit(f"{path}:{lineno}: {state} -> undefined state {target}")
+    return states
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+
+    states = parse(sys.argv[1])
+    if len(states) + 1 > 256:
+        sys.exit("too many states for an unsigned char table")
+
+    out = []
+    out.append("/* Generated by scripts/gen-grammar.py - do not edit. */")
+    out.append("")
+    out.append("typedef enum : unsigned char")
+    out.append("{")
+    out.append("    STATE_ERROR,")
+    for state in states:
+        out.append(f"    STATE_{state},")
+    out.append("    STATE_COUNT")
+    out.append("} GrammarState;")
+    out.append("")
+    out.append(f"#define GRAMMAR_START STATE_{next(iter(states))}")
+    out.append("")
+    out.append("static _Alignas(64) const unsigned char")
+    out.append("    grammar_next[STATE_COUNT][TOKEN_CLASS_COUNT] = {")
+    for state, (_, edges) in states.items():
+        if not edges:
+            continue
+        out.append(f"        [STATE_{state}] =")
+        out.append("            {")
+        for token, target in edges:
+            out.append(f"                [{token}] = STATE_{target},")
+        out.append("            },")
+    out.append("};")
+    out.append("")
+
+    with open(sys.argv[2], "w", encoding="utf-8") as f:
+        f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Generate the keyword perfect hash table used by the tokenizer.
+
+Usage: gen-keywords.py <keywords.txt> <keywords.h>
+
+The hash must stay in sync with keyword_hash() in src/scanql.c:
+
+    h = (len * A + c0 * B + c1 * C + cl * D) & (SLOTS - 1)
+
+where c0, c1 and cl are the first, second and last byte of the lexeme, each
+OR'ed with 0x20 (c1 is c0 for one-byte lexemes). The script searches small
+multipliers until every keyword lands in its own slot.
+"""
+
+import itertools
+import re
+import sys
+
+MAX_LEN = 16
+
+
+def read_keywords(path):
+    keywords = []
+    with open(path, encoding="utf-8") as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            if not re.fullmatch(r"[A-Z_]+", line):
+                sys.exit(f"{path}:{lineno}: keyword must match [A-Z_]+: {line}")
+            if len(line) > MAX_LEN:
+                sys.exit(f"{path}:{lineno}: keyword longer than {MAX_LEN}")
+            if line in keywords:
+                sys.exit(f"{path}:{lineno}: duplicate keyword {line}")
+            keywords.append(line)
+    return keywords
+
+
+def features(word):
+    b = [ord(ch) | 0x20 for ch in word]
+    c0 = b[0]
+    c1 = b[1] if len(b) > 1 else b[0]
+    return len(word), c0, c1, b[-1]
+
+
+def find_hash(keywords):
+    slots = 1
+    while slots < 2 * len(keywords):
+        slots *= 2
+
+    multipliers = range(1, 16)
+    for size in (slots, slots * 2, slots * 4):
+        for a, b, c, d in itertools.product(multipliers, repeat=4):
+            seen = set()
+            for kw in keywords:
+                n, c0, c1, cl = features(kw)
+                h = (n * a + c0 * b + c1 * c + cl * d) & (size - 1)
+                if h in seen:
+                    break
+                seen.add(h)
+            else:
+                return size, (a, b, c, d)
+    sys.exit("no perfect hash found; extend the search in gen-keywords.py")
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+
+    keywords = read_keywords(sys.argv[1])
+    size, (a, b, c, d) = find_hash(keywords)
+
+    table = [None] * size
+    for kw in keywords:
+        n, c0, c1, cl = features(kw)
+        table[(n * a + c0 * b + c1 * c + cl * d) & (size - 1)] = kw
+
+    out = []
+    out.append("/* Generated by scripts/gen-keywords.py - do not edit. */")
+    out.append("")
+    out.append(f"#define KEYWORD_MAX_LEN {MAX_LEN}")
+    out.append(f"#define KEYWORD_SLOT_COUNT {size}")
+    out.append(f"#define KEYWORD_HASH_LEN_MUL {a}u")
+    out.append(f"#define KEYWORD_HASH_FIRST_MUL {b}u")
+    out.append(f"#define KEYWORD_HASH_SECOND_MUL {c}u")
+    out.append(f"#define KEYWORD_HASH_LAST_MUL {d}u")
+    out.append("")
+    out.append("Keyword keywords[] = {")
+    for kw in keywords:
+        out.append(f'    {{"{kw.lower()}", {kw}}},')
+    out.append("};")
+    out.append("const int keyword_count = sizeof(keywords) / sizeof(keywords[0]);")
+    out.append("")
+    out.append("static const KeywordSlot keyword_slots[KEYWORD_SLOT_COUNT] = {")
+    for i, kw in enumerate(table):
+        if kw is not None:
+            out.append(f'    [{i}] = {{"{kw.lower()}", {len(kw)}, {kw}}},')
+    out.append("};")
+    out.append("")
+
+    with open(sys.argv[2], "w", encoding="utf-8") as f:
+        f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,108 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+sql_file="${1}"
+exe="${2}"
+
+dir="$(mktemp -d)"
+sock="${dir}/scanql.sock"
+"${exe}" --serve "${sock}" --jobs 4 2>/dev/null &
+server=$!
+trap 'kill "${server}" 2>/dev/null || true; rm -rf "${dir}"' EXIT
+
+for _ in $(seq 100); do
+    [[ -S "${sock}" ]] && break
+    sleep 0.05
+done
+
+# The daemon must reach the same verdicts as --file, with every statement
+# pipelined over several concurrent connections in both framings.
+expected="$("${exe}" --file "${sql_file}" | tail -n 1)" || true
+
+python3 - "${sock}" "${sql_file}" "${expected}" <<'EOF'
+import socket
+import sys
+from concurrent.futures import ThreadPoolExecutor
+
+sock_path, sql_file, expected = sys.argv[1:]
+
+def statements(text):
+    """Split like scanql_next_statement(): skip blanks and -- lines, then
+    cut after each ';' outside of quotes."""
+    i, out = 0, []
+    while i < len(text):
+        if text[i].isspace():
+            i += 1
+        elif text.startswith("--", i):
+            nl = text.find("\n", i)
+            i = len(text) if nl < 0 else nl + 1
+        else:
+            start, quote = i, None
+            while i < len(text):
+                ch = text[i]
+                i += 1
+                if quote:
+                    quote = None if ch == quote else quote
+                elif ch in "'\"":
+                    quote = ch
+                elif ch == ";":
+                    break
+            out.append(text[start:i])
+    return out
+
+def ask(requests, framed):
+    with socket.socket(socket.AF_UNIX) as s:
+        s.connect(sock_path)
+        payload = b""
+        for r in requests:
+            data = r.encode()
+            if framed or b"\n" in data:
+                payload += b"#%d\n" % len(data) + data
+            else:
+                payload += data + b"\n"
+        s.sendall(payload)
+        s.shutdown(socket.SHUT_WR)
+        reply = b""
+        while chunk := s.recv(65536):
+            reply += chunk
+    return reply.decode().splitlines()
+
+stmts = statements(open(sql_file, encoding="utf-8").read())
+parts = [stmts[i::4] for i in range(4)]
+with ThreadPoolExecutor(4) as pool:
+    replies = list(pool.map(ask, parts, [False, True, False, True]))
+
+total = sum(len(r) for r in replies)
+failed = sum(1 for r in replies for line in r if line.startswith("fail"))
+got = f"total: {total} statements, {total - failed} ok, {failed} failed"
+if total != len(stmts) or got != expected:
+    sys.exit(f"SERVE MISMATCH: '{got}' vs '{expected}'")
+
+checks = [
+    ("SELECT a FROM", "fail 13 END SQL_IDENTIFIER"),
+    ("SELECT a FROM t;", "ok"),
+    ("SELECT FROM t;", None),
+    ("", "ok"),
+]
+for sql, want in checks:
+    got = ask([sql], True)
+    if len(got) != 1 or (want and got[0] != want):
+        sys.exit(f"SERVE REPLY for '{sql}': {got}")
+    if want is None and not got[0].startswith("fail 7 FROM "):
+        sys.exit(f"SERVE REPLY for '{sql}': {got}")
+
+with socket.socket(socket.AF_UNIX) as s:
+    s.connect(sock_path)
+    s.sendall(b"SELECT a FROM t;\n#x\n")
+    s.shutdown(socket.SHUT_WR)
+    reply = s.makefile().read().splitlines()
+if reply != ["ok", "error malformed length prefix"]:
+    sys.exit(f"SERVE FRAMING: {reply}")
+EOF
+
+kill -TERM "${server}"
+wait "${server}"
+if [[ -e "${sock}" ]]; then
+    echo "SOCKET NOT REMOVED: ${sock}" >&2
+    exit 1
+fi
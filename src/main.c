@@ -1,1300 +1,1372 @@
-#include <assert.h>
-#include <ctype.h>
+#define _DEFAULT_SOURCE // clock_gettime
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
-/*
- * SqlToken - Enumeration of SQL token types
- *
- * Only the tokens needed for DML statement validation are included.
- * Parser-state symbols have been removed; transitions are encoded in
- * expected_table[] instead.
- */
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-typedef enum : unsigned short
-{
-    SELECT,
-    FROM,
-    WHERE,
-    UPDATE,
-    DELETE,
-    INSERT,
-    INTO,
-    VALUES,
-    SET,
-    JOIN,
-    CREATE,
-    TABLE,
-
-    COMMA,
-    SEMICOLON,
-    EQUALS,
-    STAR,
-
-    NUMBER,
-    DOUBLE_QUOTED_VALUE,
-    SINGLE_QUOTED_VALUE,
-    SQL_IDENTIFIER,
-    TABLE_NAME,   // SQL_IDENTIFIER promoted to table-name after TABLE keyword
-    COLUMN_NAME,  // SQL_IDENTIFIER promoted to column-name in CREATE TABLE
-    COLUMN_TYPE,  // SQL_IDENTIFIER promoted to column-type in CREATE TABLE
-    CREATE_COMMA, // COMMA after a COLUMN_TYPE — only valid in CREATE TABLE context
-    CREATE_PAREN_OPEN,  // ROUND_BRACKETS_OPEN in CREATE TABLE context
-    CREATE_PAREN_CLOSE, // ROUND_BRACKETS_CLOSE in CREATE TABLE context
-
-    AND,
-    OR,
-
-    ROUND_BRACKETS_OPEN,
-    ROUND_BRACKETS_CLOSE,
-
-    END
-} SqlSymbols;
+#include "scanql.h"
+#include "serve.h"
 
 /*
- * symbol_to_str - usage by indexing with enum value from SqlSymbols
+ * --stats. Every validating thread owns a RunStats; without --stats none is
+ * created and statements take the plain scanql_validate() path.
  */
-const char* symbol_to_str[] = {"SELECT",
-                               "FROM",
-                               "WHERE",
-                               "UPDATE",
-                               "DELETE",
-                               "INSERT",
-                               "INTO",
-                               "VALUES",
-                               "SET",
-                               "JOIN",
-                               "CREATE",
-                               "TABLE",
-
-                               "COMMA",
-                               "SEMICOLON",
-                               "EQUALS",
-                               "STAR",
-
-                               "NUMBER",
-                               "DOUBLE_QUOTED_VALUE",
-                               "SINGLE_QUOTED_VALUE",
-                               "SQL_IDENTIFIER",
-                               "TABLE_NAME",
-                               "COLUMN_NAME",
-                               "COLUMN_TYPE",
-                               "CREATE_COMMA",
-                               "CREATE_PAREN_OPEN",
-                               "CREATE_PAREN_CLOSE",
-
-                               "AND",
-                               "OR",
-
-                               "ROUND_BRACKETS_OPEN",
-                               "ROUND_BRACKETS_CLOSE",
-
-                               "END"};
-
 typedef struct
 {
-    char* value;
-    SqlSymbols type;
-    int pos; // byte offset in the original SQL string
-} Token;
-
-void print_token(Token token)
-{
-    printf("Token { value: < %s >, type: %s}\n",
-           token.value,
-           symbol_to_str[token.type]);
-}
+    scanql_profile* profile;
+    uint64_t output_ns;
+} RunStats;
 
 /**
- * struct Arena - Simple bump allocator used by the tokenizer
- * @data: backing buffer
- * @size: bytes currently used
- * @capacity: total bytes available
+ * struct StatsReport - --stats totals of all threads
+ * @counters: library counters; arena figures are summed over the threads
+ * @output_ns: time spent printing results
+ * @wall_ns: elapsed time from the first statement to the last output
+ * @threads: number of RunStats merged
  */
 typedef struct
 {
-    unsigned char* data;
-    size_t size;
-    size_t capacity;
-} Arena;
-
-typedef struct
+    scanql_stats counters;
+    uint64_t output_ns;
+    uint64_t wall_ns;
+    size_t threads;
+} StatsReport;
+
+/* Monotonic clock in nanoseconds. */
+static uint64_t now_ns(void)
 {
-    Token* elems; // Pointer to an array of Token elements, representing the
-                  // stack's contents.
-    int len; // The current length of the stack, indicating how many tokens are
-             // currently in it.
-    int cap; // The capacity of the stack, which indicates the maximum number of
-             // tokens it can hold before needing to be resized.
-} TokenStack;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
 
-/**
- * append - Append a Token to the TokenStack
- * @list: Pointer to the TokenStack to append to
- * @token: Token to append
- *
- * Return: Nothing
- */
-void append(TokenStack* list, Token token)
+/* Add the counters of @rs to @report. */
+static void stats_merge(StatsReport* report, const RunStats* rs)
 {
-    if (list && list->elems && list->len < list->cap)
-    {
-        list->elems[list->len] = token;
-        list->len += 1;
-    }
+    scanql_stats s;
+    scanql_profile_stats(rs->profile, &s);
+
+    scanql_stats* c = &report->counters;
+    c->statements += s.statements;
+    c->failed += s.failed;
+    c->bytes += s.bytes;
+    c->tokens += s.tokens;
+    for (int t = 0; t < SCANQL_TOKEN_END; t++)
+        c->tokens_by_type[t] += s.tokens_by_type[t];
+    c->lex_ns += s.lex_ns;
+    c->validate_ns += s.validate_ns;
+    c->errors_recorded += s.errors_recorded;
+    c->errors_stored += s.errors_stored;
+    c->arena_used += s.arena_used;
+    c->arena_capacity += s.arena_capacity;
+    report->output_ns += rs->output_ns;
+    report->threads++;
 }
 
-/**
- * init_static_arena - Allocate a bump arena of given capacity
- * @capacity: number of bytes to reserve
- *
- * Return: initialized Arena with allocated buffer
- */
-Arena init_static_arena(size_t capacity)
+static double ms(uint64_t ns)
 {
-    unsigned char* data = malloc(capacity);
-    Arena a             = {.data = data, .size = 0, .capacity = capacity};
-    return a;
+    return (double)ns / 1e6;
 }
 
 /**
- * static_arena_alloc - Allocate a slice from the arena without freeing
- * @arena: arena to allocate from
- * @size: bytes requested
+ * print_stats - Print a --stats report
+ * @out: stream to print to
+ * @r: report to print
+ * @json: print one JSON object instead of the human-readable summary
  *
- * Return: pointer to allocated slice or NULL if insufficient space
+ * Times of several threads are summed, so with --jobs they are CPU time
+ * rather than elapsed time; @r->wall_ns is always elapsed time.
  */
-static void* static_arena_alloc(Arena* arena, size_t size)
+static void print_stats(FILE* out, const StatsReport* r, bool json)
 {
-    if (!arena || !arena->data)
-        return NULL;
+    const scanql_stats* c = &r->counters;
 
-    if (arena->size + size <= arena->capacity)
+    if (json)
     {
-        unsigned char* data = &arena->data[arena->size];
-        arena->size += size;
-        return data;
+        fprintf(out,
+                "{\"statements\":%" PRIu64 ",\"failed\":%" PRIu64
+                ",\"bytes\":%" PRIu64 ",\"tokens\":%" PRIu64
+                ",\"threads\":%zu,\"time_ns\":{\"lex\":%" PRIu64
+                ",\"validate\":%" PRIu64 ",\"output\":%" PRIu64
+                ",\"wall\":%" PRIu64 "},\"tokens_by_type\":{",
+                c->statements,
+                c->failed,
+                c->bytes,
+                c->tokens,
+                r->threads,
+                c->lex_ns,
+                c->validate_ns,
+                r->output_ns,
+                r->wall_ns);
+        for (int t = 0; t < SCANQL_TOKEN_END; t++)
+            fprintf(out,
+                    "%s\"%s\":%" PRIu64,
+                    t ? "," : "",
+                    scanql_token_name((scanql_token_type)t),
+                    c->tokens_by_type[t]);
+        fprintf(out,
+                "},\"arena\":{\"used\":%zu,\"capacity\":%zu}"
+                ",\"errors\":{\"recorded\":%" PRIu64 ",\"stored\":%" PRIu64
+                "}}\n",
+                c->arena_used,
+                c->arena_capacity,
+                c->errors_recorded,
+                c->errors_stored);
+        return;
     }
-    return NULL;
+
+    fprintf(out,
+            "stats: %" PRIu64 " statements (%" PRIu64 " failed), %" PRIu64
+            " bytes, %" PRIu64 " tokens\n",
+            c->statements,
+            c->failed,
+            c->bytes,
+            c->tokens);
+    fprintf(out,
+            "  time: lex %.3f ms, validate %.3f ms, output %.3f ms, "
+            "wall %.3f ms on %zu thread%s\n",
+            ms(c->lex_ns),
+            ms(c->validate_ns),
+            ms(r->output_ns),
+            ms(r->wall_ns),
+            r->threads,
+            r->threads == 1 ? "" : "s");
+    fprintf(out, "  tokens:");
+    const char* sep = " ";
+    for (int t = 0; t < SCANQL_TOKEN_END; t++)
+    {
+        if (c->tokens_by_type[t] == 0)
+            continue;
+        fprintf(out,
+                "%s%s %" PRIu64,
+                sep,
+                scanql_token_name((scanql_token_type)t),
+                c->tokens_by_type[t]);
+        sep = ", ";
+    }
+    fprintf(out,
+            "\n  arena: %zu of %zu bytes used\n"
+            "  errors: %" PRIu64 " recorded, %" PRIu64 " stored\n",
+            c->arena_used,
+            c->arena_capacity,
+            c->errors_recorded,
+            c->errors_stored);
 }
 
-/**
- * arena_free - Release arena backing memory
- * @arena: arena to free
+/*
+ * Output. Everything the tool prints to stdout is rendered into a Writer,
+ * which goes out with a single fwrite() whenever its buffer fills up; stdout
+ * itself is unbuffered. A Writer without a stream only grows, to collect
+ * the output of a batch task in memory.
  */
-void arena_free(Arena* arena)
-{
-    if (!arena)
-        return;
-    free(arena->data);
-    arena->data     = NULL;
-    arena->size     = 0;
-    arena->capacity = 0;
-}
+#define WRITER_CAPACITY (1 << 20)
 
 /**
- * fuzzy_match - Check whether two strings are similar (1 char tolerance)
- * @to_compare: the input string to test
- * @compare_to: the reference string to match against
- *
- * Returns false immediately when @to_compare is shorter than @compare_to.
- * Otherwise counts character mismatches up to the shorter length and returns
- * true when fewer than 2 differences are found.
- *
- * NOTE: Simple algorithm; only fuzzy for strings of similar length.
- *
- * Return: true if strings are considered a match, false otherwise.
+ * struct Writer - Output buffer
+ * @data: buffered bytes
+ * @len: bytes in @data
+ * @cap: size of @data
+ * @fp: stream @data is flushed to, or NULL to keep everything in memory
+ * @error: a write failed or the buffer could not grow
  */
-bool fuzzy_match(const char* to_compare, const char* compare_to)
+typedef struct
+{
+    char* data;
+    size_t len;
+    size_t cap;
+    FILE* fp;
+    bool error;
+} Writer;
+
+static void writer_flush(Writer* w)
 {
-    // NOTE: Bad fuzzy match algo, but is fuzzy only on bigger length
-    int differences = 0;
+    if (w->len > 0 && fwrite(w->data, 1, w->len, w->fp) != w->len)
+        w->error = true;
+    w->len = 0;
+}
 
-    int to_compare_len = strlen(to_compare);
-    int compare_to_len = strlen(compare_to);
+/* Make room for @n more bytes; NULL if the buffer could not grow. */
+static char* writer_reserve(Writer* w, size_t n)
+{
+    if (w->cap - w->len >= n)
+        return w->data + w->len;
+    if (w->fp)
+        writer_flush(w);
+    if (w->cap - w->len < n)
+    {
+        size_t cap = w->cap ? w->cap : 4096;
+        while (cap - w->len < n)
+            cap *= 2;
+        char* grown = realloc(w->data, cap);
+        if (!grown)
+        {
+            w->error = true;
+            return NULL;
+        }
+        w->data = grown;
+        w->cap  = cap;
+    }
+    return w->data + w->len;
+}
 
-    if (to_compare_len < compare_to_len)
+static void writer_put(Writer* w, const char* s, size_t n)
+{
+    /* Large blocks skip the buffer */
+    if (w->fp && n >= w->cap)
     {
-        return false;
+        writer_flush(w);
+        if (fwrite(s, 1, n, w->fp) != n)
+            w->error = true;
+        return;
     }
 
-    int shorter_len =
-        compare_to_len < to_compare_len ? compare_to_len : to_compare_len;
+    char* p = writer_reserve(w, n);
+    if (!p)
+        return;
+    memcpy(p, s, n);
+    w->len += n;
+}
+
+static void writer_puts(Writer* w, const char* s)
+{
+    writer_put(w, s, strlen(s));
+}
 
-    for (int i = 0; i < shorter_len; i++)
-    {
-        int to_compare_char = toupper(to_compare[i]);
+static void writer_u64(Writer* w, uint64_t v)
+{
+    char digits[20];
+    size_t i = sizeof(digits);
+    do
+        digits[--i] = (char)('0' + v % 10);
+    while ((v /= 10) != 0);
+    writer_put(w, digits + i, sizeof(digits) - i);
+}
 
-        bool in = false;
-        for (int j = i; j < shorter_len; j++)
-        {
-            if (to_compare_char == toupper(compare_to[j]) && i == j)
-            {
-                in = true;
-                break;
-            }
-        }
+static void writer_printf(Writer* w, const char* fmt, ...)
+    __attribute__((format(printf, 2, 3)));
 
-        if (!in)
-        {
-            differences++;
-        }
-    }
+static void writer_printf(Writer* w, const char* fmt, ...)
+{
+    size_t room = w->cap - w->len;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(room ? w->data + w->len : NULL, room, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
 
-    if (differences < 2)
+    if ((size_t)n >= room)
     {
-        return true;
+        char* p = writer_reserve(w, (size_t)n + 1);
+        if (!p)
+            return;
+        va_start(ap, fmt);
+        vsnprintf(p, (size_t)n + 1, fmt, ap);
+        va_end(ap);
     }
-
-    return false;
+    w->len += (size_t)n;
 }
 
+/* Output formats of --format */
+typedef enum
+{
+    FORMAT_TEXT,  // human-readable report with a caret under the error
+    FORMAT_JSONL, // one JSON object per statement
+    FORMAT_TSV,   // one tab-separated line per statement
+} OutputFormat;
+
 /**
- * match - Case-insensitive exact string comparison
- * @to_compare: the input string to test
- * @compare_to: the reference string to match against
- *
- * Return: true if both strings have equal length and identical characters
- *         (ignoring case), false otherwise.
+ * struct RunOptions - Settings shared by every validated statement
+ * @max_errors: errors to look for in a failing statement, 0 for all
+ * @format: how results are printed
+ * @print_flags: SCANQL_PRINT_* flags of FORMAT_TEXT
+ * @lines: line index of the input, or NULL if the input is gone
+ * @populate: prefault a mapped input file, see load_input()
+ * @cache: verdict cache shared by all threads, or NULL
  */
-bool match(const char* to_compare, const char* compare_to)
+typedef struct
+{
+    size_t max_errors;
+    OutputFormat format;
+    unsigned print_flags;
+    scanql_lines* lines;
+    bool populate;
+    scanql_cache* cache;
+} RunOptions;
+
+/* Names of the token types in @expected as "A|B|C", or JSON strings. */
+static void
+writer_expected(Writer* w, uint64_t expected, const char* sep, bool json)
 {
-    unsigned long compare_to_len = strlen(compare_to);
-    if (strlen(to_compare) == compare_to_len)
+    for (uint64_t rest = expected; rest; rest &= rest - 1)
     {
-        for (int i = 0; i < (int)compare_to_len; i++)
-        {
-            if (toupper(to_compare[i]) != toupper(compare_to[i]))
-            {
-                return false;
-            }
-        }
-        return true;
+        const char* name =
+            scanql_token_name((scanql_token_type)__builtin_ctzll(rest));
+        if (rest != expected)
+            writer_puts(w, sep);
+        if (json)
+            writer_put(w, "\"", 1);
+        writer_puts(w, name);
+        if (json)
+            writer_put(w, "\"", 1);
     }
-    return false;
 }
 
-typedef Token Keyword;
-Keyword keywords[] = {
-    {"select", SELECT, 0},
-    {"from", FROM, 0},
-    {"where", WHERE, 0},
-    {"insert", INSERT, 0},
-    {"into", INTO, 0},
-    {"update", UPDATE, 0},
-    {"delete", DELETE, 0},
-    {"values", VALUES, 0},
-    {"set", SET, 0},
-    {"join", JOIN, 0},
-    {"and", AND, 0},
-    {"or", OR, 0},
-    {"create", CREATE, 0},
-    {"table", TABLE, 0},
-};
-const int keyword_count = sizeof(keywords) / sizeof(keywords[0]);
+/* scanql_format_result() with input line numbers where there is an index */
+static size_t format_text(char* out,
+                          size_t cap,
+                          const RunOptions* opt,
+                          const char* sql,
+                          scanql_span span,
+                          const scanql_result* res)
+{
+    if (opt->lines && sql)
+        return scanql_format_result_in(
+            out, cap, opt->lines, span, res, opt->print_flags);
+    return scanql_format_result(
+        out, cap, sql, span.length, res, opt->print_flags);
+}
 
 /**
- * get_tokens - Tokenize a SQL string into a TokenStack
- * @sql: input SQL text
- * @arena: arena for storing token lexeme strings
+ * emit_result - Print the verdict of one statement
+ * @w: output
+ * @opt: output format
+ * @index: 1-based statement number, 0 for a lone statement
+ * @sql: text of the statement, or NULL if it is gone
+ * @span: input offsets of the statement
+ * @res: verdict; @res->error.offset is relative to @span
  *
- * Note: This is a very small tokenizer tailored to the validator. It is not a
- * full SQL lexer.
+ * FORMAT_TEXT prefixes statements with "[index] " unless @index is 0. The
+ * machine-readable formats give input offsets and always carry the number;
+ * with a line index they also give the line and column of the error.
  */
-TokenStack get_tokens(const char* sql, Arena* arena)
+static void emit_result(Writer* w,
+                        const RunOptions* opt,
+                        size_t index,
+                        const char* sql,
+                        scanql_span span,
+                        const scanql_result* res)
 {
-    assert(sql != NULL);
-    assert(arena != NULL);
-
-    size_t txt_len    = strlen(sql);
-    size_t tokenCount = txt_len ? txt_len : 1;
-
-    TokenStack tokenList = {
-        .elems = (Token*)static_arena_alloc(arena, tokenCount * sizeof(Token)),
-        .len   = 0,
-        .cap   = (int)tokenCount,
-    };
-
-    int index      = 0;
-    int last_index = (int)txt_len;
-
-    char c = ' ';
-    while (index < last_index)
+    if (opt->format == FORMAT_TEXT)
     {
-        char seperators[255] = " \t\n";
-        c                    = sql[index];
-        Token token          = {};
-        bool is_single       = false;
+        if (index)
+            writer_printf(w, "[%zu] ", index);
 
-        switch (c)
+        size_t room = w->cap - w->len;
+        size_t n    = format_text(
+            room ? w->data + w->len : NULL, room, opt, sql, span, res);
+        if (n >= room)
         {
-            case ' ':
-            case '\t':
-            case '\n':
-                index++;
-                continue;
-
-            case ',':
-                token.type = COMMA;
-                is_single  = true;
-                break;
-
-            case ';':
-                token.type = SEMICOLON;
-                is_single  = true;
-                break;
-
-            case '=':
-                token.type = EQUALS;
-                is_single  = true;
-                break;
-            case '(':
-                token.type = ROUND_BRACKETS_OPEN;
-                is_single  = true;
-                break;
-            case ')':
-                token.type = ROUND_BRACKETS_CLOSE;
-                is_single  = true;
-                break;
-
-            case '*':
-                token.type = STAR;
-                is_single  = true;
-                break;
-
-            case '"':
-                token.type = DOUBLE_QUOTED_VALUE;
-                strcpy(seperators, "\"");
-                index++; // skip current seperator
-                break;
-            case '\'':
-                token.type = SINGLE_QUOTED_VALUE;
-                strcpy(seperators, "'");
-                index++; // skip current seperator
-                break;
-
-            default:
-                if (isalpha(c) || c == '_')
-                {
-                    token.type = SQL_IDENTIFIER;
-                    strcat(seperators, ",;()=");
-                }
-                else if (isdigit(c))
-                {
-                    token.type = NUMBER;
-                    strcat(seperators, ",;()=");
-                }
-                else
-                {
-                    /* Unknown character: skip it and continue */
-                    index++;
-                    continue;
-                }
-        }
-
-        int start  = index;
-        token.pos  = start;
-        if (is_single)
-        {
-            index++;
+            char* p = writer_reserve(w, n + 1);
+            if (!p)
+                return;
+            format_text(p, n + 1, opt, sql, span, res);
         }
-        else
-        {
+        w->len += n;
+        return;
+    }
 
-            // NOTE: +1 include the \0 terminator for absolute end else crash at
-            // the end because of the justified assert
-            for (int char_idx = index; char_idx < (int)txt_len + 1; char_idx++)
-            {
-                bool is_seperator = false;
-                char current_char = toupper(sql[char_idx]);
-                // check for seperators
-                for (int sep_idx = 0; sep_idx < (int)strlen(seperators);
-                     sep_idx++)
-                {
-                    if (current_char == toupper(seperators[sep_idx]) ||
-                        current_char == '\0')
-                    {
-                        is_seperator = true;
-                        break;
-                    }
-                }
-
-                if (is_seperator)
-                {
-                    index = char_idx;
-                    break;
-                }
-            }
-        }
-        int end = index;
-        assert(end > start && "end should be bigger than start");
+    bool json       = opt->format == FORMAT_JSONL;
+    const char* sep = json ? "," : "\t";
+    if (json)
+        writer_puts(w, "{\"statement\":");
+    writer_u64(w, index ? index : 1);
+    writer_puts(w, json ? ",\"start\":" : sep);
+    writer_u64(w, span.offset);
+    writer_puts(w, json ? ",\"length\":" : sep);
+    writer_u64(w, span.length);
+    if (json)
+        writer_puts(w, res->ok ? ",\"ok\":true" : ",\"ok\":false");
+    else
+        writer_puts(w, res->ok ? "\tok" : "\tfail");
+    writer_puts(w, json ? ",\"errors\":" : sep);
+    writer_u64(w, res->error_count);
 
-        if (sql[index] == '"' || sql[index] == '\'') // consume specific
-                                                     // string seperators
+    if (!res->ok)
+    {
+        size_t offset       = span.offset + res->error.offset;
+        scanql_position pos = {0, 0};
+        bool located =
+            opt->lines && scanql_lines_locate(opt->lines, offset, &pos);
+
+        writer_puts(w, json ? ",\"offset\":" : sep);
+        writer_u64(w, offset);
+        if (located || !json)
         {
-            index++;
+            writer_puts(w, json ? ",\"line\":" : sep);
+            if (located)
+                writer_u64(w, pos.line);
+            writer_puts(w, json ? ",\"column\":" : sep);
+            if (located)
+                writer_u64(w, pos.column);
         }
-
-        token.value = static_arena_alloc(arena, (size_t)(end - start) + 1);
-        strncpy(token.value, sql + start, (size_t)(end - start));
-        token.value[end - start] = '\0';
-
-        // keyword check
-        for (int i = 0; i < keyword_count; i++)
+        writer_puts(w, json ? ",\"token\":\"" : sep);
+        writer_puts(w, scanql_token_name(res->error.type));
+        writer_puts(w, json ? "\",\"expected\":[" : sep);
+        writer_expected(w, res->expected, json ? "," : "|", json);
+        if (json)
+            writer_put(w, "]", 1);
+
+        scanql_token_type hint = sql ? scanql_suggest(sql, span.length, res)
+                                     : SCANQL_TOKEN_END;
+        if (hint != SCANQL_TOKEN_END || !json)
         {
-            Keyword keyword = keywords[i];
-            if (match(token.value, keyword.value))
-            {
-                token.type = keyword.type;
-                break;
-            }
+            writer_puts(w, json ? ",\"suggestion\":\"" : sep);
+            if (hint != SCANQL_TOKEN_END)
+                writer_puts(w, scanql_token_name(hint));
+            if (json)
+                writer_put(w, "\"", 1);
         }
-
-        append(&tokenList, token);
     }
-    return tokenList;
+    else if (!json)
+    {
+        writer_puts(w, "\t\t\t\t\t\t");
+    }
+    writer_puts(w, json ? "}\n" : "\n");
 }
 
 /**
- * struct Valid_Symbols - Represents a set of valid expected symbols
- * @valids: array of valid symbols
- * @len: number of valid symbols
+ * run_statement - Validate one statement and print the result
+ * @out: output
+ * @opt: error limit and output format
+ * @index: 1-based statement number, 0 for a lone statement
+ * @buf: input the statement is part of
+ * @stmt: the statement inside @buf
+ * @stats: --stats counters of the calling thread, or NULL
+ *
+ * Return: true if the statement is valid, false otherwise.
  */
-typedef struct
+static bool run_statement(Writer* out,
+                          const RunOptions* opt,
+                          size_t index,
+                          const char* buf,
+                          scanql_span stmt,
+                          RunStats* stats)
 {
-    SqlSymbols valids[15]; // max symbols
-    unsigned char len; // The current length of the Valid_Symbols, indicating
-                       // how many valids there actually are
-} Valid_Symbols;
+    const char* sql   = buf + stmt.offset;
+    scanql_result res = {.error_limit = opt->max_errors};
+    if (!stats)
+    {
+        scanql_validate_cached(opt->cache, sql, stmt.length, &res);
+        emit_result(out, opt, index, sql, stmt, &res);
+        return res.ok;
+    }
 
-/**
- * struct ValidationError - A single validation error detail
- * @token: offending token (NULL when the error relates to EOF)
- * @position: index in the token stream (0-based)
- * @expected: parser state that was expected at this position
- * @message: human-readable diagnostic message
- */
-typedef struct
-{
-    const Token* token;
-    int position;
-    Valid_Symbols expected;
-    const char* message;
-} ValidationError;
+    scanql_validate_profiled(stats->profile, sql, stmt.length, &res);
+    uint64_t t0 = now_ns();
+    emit_result(out, opt, index, sql, stmt, &res);
+    stats->output_ns += now_ns() - t0;
+    return res.ok;
+}
 
 /**
- * struct ValidationResult - Aggregated validation outcome
- * @ok: true when no errors were found
- * @error_count: total number of errors detected (may exceed capacity)
- * @error_capacity: capacity of the caller-provided @errors buffer
- * @errors: pointer to caller-provided buffer to store up to @error_capacity
- * errors
- * @sql: original SQL string, used for context printing (may be NULL)
+ * struct Input - Whole input of --file, mapped or read into memory
+ * @data: the input bytes; not NUL-terminated
+ * @len: bytes in @data
+ * @mapped: @data is a read-only mapping of the file, else a heap buffer
  */
 typedef struct
 {
-    bool ok;
-    size_t error_count;
-    size_t error_capacity;
-    ValidationError* errors;
-    const char* sql;
-} ValidationResult;
+    const char* data;
+    size_t len;
+    bool mapped;
+} Input;
 
 /**
- * record_error - Append an error into the result buffer if space remains
- * @r: validation result accumulator
- * @tok: offending token (NULL for EOF)
- * @pos: token index
- * @expected: expected parser state
- * @msg: short diagnostic string (must outlive the result)
- */
-static void record_error(ValidationResult* r,
-                         const Token* tok,
-                         int pos,
-                         Valid_Symbols expected,
-                         const char* msg)
-{
-    assert(r != NULL);
-    r->ok = false;
-    if (r->error_count < r->error_capacity)
-    {
-        ValidationError* e = &r->errors[r->error_count];
-        e->token           = tok;
-        e->position        = pos;
-        e->expected        = expected;
-        e->message         = msg;
-    }
-    r->error_count++;
-}
-
-/*
- * expected_table - Transition table for the table-driven validator
- *
- * Indexed by SqlSymbols enum value. Each entry holds the set of valid token
- * types that may follow the given token. The validator walks the token stream
- * and looks up this table after every accepted token to advance the expected
- * set. END is included in terminal positions so that a query may end without
- * a trailing semicolon where appropriate.
- */
-const Valid_Symbols expected_table[] = {
-    [SELECT] = {{SQL_IDENTIFIER, STAR}, 2},
-    [FROM]   = {{SQL_IDENTIFIER}, 1},
-    [WHERE]  = {{SQL_IDENTIFIER}, 1},
-    [UPDATE] = {{SQL_IDENTIFIER}, 1},
-    [DELETE] = {{FROM}, 1},
-    [INSERT] = {{INTO}, 1},
-    [INTO]   = {{SQL_IDENTIFIER}, 1},
-    [VALUES] = {{ROUND_BRACKETS_OPEN}, 1},
-    [SET]    = {{SQL_IDENTIFIER}, 1},
-    [JOIN]   = {{SQL_IDENTIFIER}, 1},
-    [CREATE] = {{TABLE}, 1},
-    [TABLE]  = {{TABLE_NAME}, 1},
-    [COMMA]     = {{SQL_IDENTIFIER,
-                    STAR,
-                    NUMBER,
-                    SINGLE_QUOTED_VALUE,
-                    DOUBLE_QUOTED_VALUE},
-                   5},
-    [SEMICOLON] = {{END}, 1},
-    [EQUALS] =
-        {{NUMBER, SINGLE_QUOTED_VALUE, DOUBLE_QUOTED_VALUE, SQL_IDENTIFIER}, 4},
-    [STAR] = {{COMMA, FROM, END}, 3},
-
-    [NUMBER] = {{COMMA, SEMICOLON, AND, OR, WHERE, ROUND_BRACKETS_CLOSE, END},
-                7},
-    [DOUBLE_QUOTED_VALUE] =
-        {{COMMA, SEMICOLON, AND, OR, WHERE, ROUND_BRACKETS_CLOSE, END}, 7},
-    [SINGLE_QUOTED_VALUE] =
-        {{COMMA, SEMICOLON, AND, OR, WHERE, ROUND_BRACKETS_CLOSE, END}, 7},
-    [SQL_IDENTIFIER] = {{COMMA,
-                         FROM,
-                         WHERE,
-                         EQUALS,
-                         SEMICOLON,
-                         AND,
-                         OR,
-                         JOIN,
-                         ROUND_BRACKETS_CLOSE,
-                         SET,
-                         VALUES,
-                         END},
-                        12},
-    /* TABLE_NAME: a SQL_IDENTIFIER promoted to the table-name after TABLE. */
-    [TABLE_NAME] = {{CREATE_PAREN_OPEN}, 1},
-    /* COLUMN_NAME: a SQL_IDENTIFIER promoted to the name-position in CREATE TABLE. */
-    [COLUMN_NAME] = {{COLUMN_TYPE}, 1},
-    /* COLUMN_TYPE: a SQL_IDENTIFIER promoted to the type-position in CREATE TABLE.
-     * After a column type: either more columns via CREATE_COMMA, or close paren. */
-    [COLUMN_TYPE] = {{CREATE_COMMA, CREATE_PAREN_CLOSE}, 2},
-    /* CREATE_COMMA: a COMMA token in CREATE TABLE column-list context. */
-    [CREATE_COMMA] = {{COLUMN_NAME}, 1},
-    /* CREATE_PAREN_OPEN: a ( token in CREATE TABLE context. */
-    [CREATE_PAREN_OPEN] = {{COLUMN_NAME}, 1},
-    /* CREATE_PAREN_CLOSE: a ) token in CREATE TABLE context. */
-    [CREATE_PAREN_CLOSE] = {{SEMICOLON, END}, 2},
-
-    [AND] = {{SQL_IDENTIFIER}, 1},
-    [OR]  = {{SQL_IDENTIFIER}, 1},
-
-    [ROUND_BRACKETS_OPEN] =
-        {{SQL_IDENTIFIER, NUMBER, SINGLE_QUOTED_VALUE, DOUBLE_QUOTED_VALUE}, 4},
-    [ROUND_BRACKETS_CLOSE] = {{COMMA, SEMICOLON, AND, OR, WHERE, END}, 6},
-
-    [END] = {{END}, 1}};
-
-/**
- * validate_query_with_errors - Validate and collect all errors
- * @tokens: token stack to validate
- * @result: output accumulator (caller provides storage)
+ * read_input - Read a whole stream into a heap buffer
+ * @fp: stream to read from
+ * @len: receives the number of bytes read
  *
- * Returns: true if no errors, false otherwise. Continues after mismatches.
+ * Return: malloc'd buffer owned by the caller, or NULL on error.
  */
-bool validate_query_with_errors(const TokenStack* tokens,
-                                ValidationResult* result)
+static char* read_input(FILE* fp, size_t* len)
 {
-    assert(tokens != NULL);
-    assert(result != NULL);
-
-    result->ok          = true;
-    result->error_count = 0;
-
-    if (tokens->len == 0)
-    {
-        return true;
-    }
-
-    Valid_Symbols expected = {{SELECT, UPDATE, DELETE, INSERT, CREATE}, 5};
+    size_t cap  = 1 << 16;
+    size_t used = 0;
+    char* buf   = malloc(cap);
+    if (!buf)
+        return NULL;
 
-    for (int i = 0; i <= tokens->len; i++)
+    size_t n;
+    while ((n = fread(buf + used, 1, cap - used, fp)) > 0)
     {
-        bool is_eof       = (i == tokens->len);
-        const Token* t    = is_eof ? NULL : &tokens->elems[i];
-        SqlSymbols t_type = is_eof ? END : t->type;
-
-        /* Promote real tokens to virtual symbols when those virtual symbols
-         * are expected (CREATE TABLE column-definition context).
-         * SQL_IDENTIFIER → TABLE_NAME / COLUMN_NAME / COLUMN_TYPE
-         * COMMA → CREATE_COMMA
-         * ROUND_BRACKETS_OPEN → CREATE_PAREN_OPEN
-         * ROUND_BRACKETS_CLOSE → CREATE_PAREN_CLOSE */
-        if (t_type == SQL_IDENTIFIER)
-        {
-            for (int j = 0; j < expected.len; j++)
-            {
-                if (expected.valids[j] == TABLE_NAME ||
-                    expected.valids[j] == COLUMN_NAME ||
-                    expected.valids[j] == COLUMN_TYPE)
-                {
-                    t_type = expected.valids[j];
-                    break;
-                }
-            }
-        }
-        else if (t_type == COMMA)
-        {
-            for (int j = 0; j < expected.len; j++)
-            {
-                if (expected.valids[j] == CREATE_COMMA)
-                {
-                    t_type = CREATE_COMMA;
-                    break;
-                }
-            }
-        }
-        else if (t_type == ROUND_BRACKETS_OPEN)
+        used += n;
+        if (used == cap)
         {
-            for (int j = 0; j < expected.len; j++)
+            char* grown = realloc(buf, cap * 2);
+            if (!grown)
             {
-                if (expected.valids[j] == CREATE_PAREN_OPEN)
-                {
-                    t_type = CREATE_PAREN_OPEN;
-                    break;
-                }
+                free(buf);
+                return NULL;
             }
+            buf = grown;
+            cap *= 2;
         }
-        else if (t_type == ROUND_BRACKETS_CLOSE)
-        {
-            for (int j = 0; j < expected.len; j++)
-            {
-                if (expected.valids[j] == CREATE_PAREN_CLOSE)
-                {
-                    t_type = CREATE_PAREN_CLOSE;
-                    break;
-                }
-            }
-        }
-
-        bool is_valid = false;
-        for (int j = 0; j < expected.len; j++)
-        {
-            if (t_type == expected.valids[j])
-            {
-                is_valid = true;
-                break;
-            }
-        }
-
-        if (!is_valid)
-        {
-            record_error(result, t, i, expected, "unexpected token");
-            continue; // Continue parsing to accumulate errors
-        }
+    }
 
-        if (!is_eof)
-        {
-            expected = expected_table[t_type];
-        }
+    if (ferror(fp))
+    {
+        free(buf);
+        return NULL;
     }
 
-    return result->ok;
+    *len = used;
+    return buf;
 }
 
 /**
- * validate_query - Convenience wrapper that only reports success/failure
- * @tokens: token stack to validate
+ * map_input - Map a regular file read-only for one front-to-back pass
+ * @fd: open file, read from its start
+ * @populate: prefault the whole file with MAP_POPULATE where available
+ * @in: receives the mapping
+ *
+ * The statements are lexed straight out of the page cache, so a file costs
+ * no resident memory of its own, and repeated runs over the same files
+ * find it still cached. Read-ahead is asked for along the whole file.
  *
- * Returns: true if query is valid, false otherwise.
+ * Return: false if @fd is no non-empty regular file or cannot be mapped;
+ * the caller then reads it instead.
  */
-bool validate_query(const TokenStack* tokens)
+static bool map_input(int fd, bool populate, Input* in)
 {
-    if (!tokens)
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        (uintmax_t)st.st_size > SIZE_MAX || lseek(fd, 0, SEEK_CUR) != 0)
         return false;
 
-    ValidationError buf[tokens->len + 2];
-    ValidationResult res = {
-        .ok             = true,
-        .error_count    = 0,
-        .error_capacity = sizeof(buf) / sizeof(buf[0]),
-        .errors         = buf,
-    };
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (populate)
+        flags |= MAP_POPULATE;
+#else
+    (void)populate;
+#endif
+    size_t len = (size_t)st.st_size;
+    void* data = mmap(NULL, len, PROT_READ, flags, fd, 0);
+    if (data == MAP_FAILED)
+        return false;
 
-    return validate_query_with_errors(tokens, &res);
-}
+    /* Only hints; the input is valid without them */
+    (void)posix_madvise(data, len, POSIX_MADV_SEQUENTIAL);
+    (void)posix_madvise(data, len, POSIX_MADV_WILLNEED);
 
-#define CLR_RED "\033[31m"
-#define CLR_YEL "\033[33m"
-#define CLR_GRN "\033[32m"
-#define CLR_DIM "\033[90m"
-#define CLR_RESET "\033[0m"
+    *in = (Input){.data = data, .len = len, .mapped = true};
+    return true;
+}
 
 /**
- * describe_token - Render a token into a small textual description
- * @e: validation error holding the token
- * @buf: output buffer
- * @n: buffer size
+ * load_input - Map or read a whole file, or stdin for "-"
+ * @path: file to read
+ * @populate: passed on to map_input()
+ * @in: receives the input; release it with input_free()
+ *
+ * Regular files, also as redirected stdin, are mapped; pipes and other
+ * streams are read into a heap buffer. Errors are reported on stderr.
+ *
+ * Return: true on success.
  */
-static void describe_token(const ValidationError* e, char* buf, size_t n)
+static bool load_input(const char* path, bool populate, Input* in)
 {
-    if (!e || !buf || n == 0)
-        return;
-
-    const Token* t = e->token;
-    if (!t)
+    bool is_stdin = strcmp(path, "-") == 0;
+    FILE* fp      = is_stdin ? stdin : fopen(path, "rb");
+    if (!fp)
     {
-        snprintf(buf, n, "<EOF>");
-        return;
+        perror(path);
+        return false;
     }
 
-    const char* kind = symbol_to_str[t->type];
-    const char* val  = (t->value && t->value[0]) ? t->value : "";
+    bool ok = map_input(fileno(fp), populate, in);
+    if (!ok)
+    {
+        size_t len = 0;
+        char* buf  = read_input(fp, &len);
+        *in        = (Input){.data = buf, .len = len};
+        ok         = buf != NULL;
+        if (!ok)
+            fprintf(stderr, "%s: read error\n", path);
+    }
+    if (!is_stdin)
+        fclose(fp);
+    return ok;
+}
 
-    if (val[0])
-        snprintf(buf, n, "%s \"%s\"", kind, val);
+/* Release what load_input() set up. */
+static void input_free(Input* in)
+{
+    if (in->mapped)
+        munmap((void*)in->data, in->len);
     else
-        snprintf(buf, n, "%s", kind);
+        free((void*)in->data);
+    *in = (Input){0};
 }
 
+/*
+ * Parallel batch validation. The statement ranges are grouped into tasks of
+ * consecutive statements; every worker owns a contiguous slice of the tasks
+ * and works through it front to back, and a worker that runs dry steals from
+ * the back of another worker's slice. Each task renders its output into its
+ * own in-memory Writer, and the main thread passes finished tasks on to the
+ * output in input order.
+ */
+#define BATCH_TASK_BYTES (64 * 1024)
+#define BATCH_TASK_STATEMENTS 4096
+#define BATCH_CACHE_ENTRIES 4096
+
 /**
- * token_name - Write only the type name of a token's offending error into buf
- * @e: validation error holding the token (may be NULL)
- * @buf: output buffer
- * @n: buffer size
+ * struct BatchTask - Run of consecutive statements validated as one unit
+ * @first: index of the first statement
+ * @count: number of statements
+ * @failed: statements that did not validate
+ * @out: rendered output; @out.error if it could not be rendered
+ * @done: set under BatchPool.done_lock once the fields above are final
  */
-static void token_name(const ValidationError* e, char* buf, size_t n)
+typedef struct
 {
-    if (!buf || n == 0)
-        return;
-
-    const Token* t = e ? e->token : NULL;
-    if (!t)
-    {
-        snprintf(buf, n, "<EOF>");
-        return;
-    }
-
-    snprintf(buf, n, "%s", symbol_to_str[t->type]);
-}
+    size_t first;
+    size_t count;
+    size_t failed;
+    Writer out;
+    bool done;
+} BatchTask;
 
 /**
- * expected_to_str - Convert expected state to string label
+ * struct TaskDeque - Tasks [head, tail) not yet taken from one worker's slice
+ * @lock: protects @head and @tail
+ * @head: next task for the owner
+ * @tail: one past the task a thief takes next
  */
-static void expected_to_str(Valid_Symbols e, char* buf, size_t n)
+typedef struct
 {
-    if (!buf || n == 0)
-        return;
+    pthread_mutex_t lock;
+    size_t head;
+    size_t tail;
+} TaskDeque;
+
+typedef struct
+{
+    const char* buf;
+    const scanql_span* stmts;
+    BatchTask* tasks;
+    TaskDeque* deques;
+    size_t workers;
+    const RunOptions* opt;
+    RunStats* stats;
+    pthread_mutex_t done_lock;
+    pthread_cond_t done_cond;
+} BatchPool;
+
+typedef struct
+{
+    BatchPool* pool;
+    size_t id;
+} BatchWorker;
 
-    buf[0] = '\0';
-    for (int i = 0; i < e.len; i++)
+/* Take the next own task, or steal one from the back of another worker. */
+static bool batch_take(BatchPool* pool, size_t self, size_t* task)
+{
+    for (size_t k = 0; k < pool->workers; k++)
     {
-        /* Map virtual CREATE TABLE symbols to their real token names */
-        const char* name;
-        SqlSymbols sym = e.valids[i];
-        if (sym == TABLE_NAME || sym == COLUMN_NAME || sym == COLUMN_TYPE)
-            name = symbol_to_str[SQL_IDENTIFIER];
-        else if (sym == CREATE_COMMA)
-            name = symbol_to_str[COMMA];
-        else if (sym == CREATE_PAREN_OPEN)
-            name = symbol_to_str[ROUND_BRACKETS_OPEN];
-        else if (sym == CREATE_PAREN_CLOSE)
-            name = symbol_to_str[ROUND_BRACKETS_CLOSE];
-        else
-            name = symbol_to_str[sym];
+        TaskDeque* dq = &pool->deques[(self + k) % pool->workers];
+        bool found    = false;
 
-        strncat(buf, name, n - strlen(buf) - 1);
-        if (i < e.len - 1)
+        pthread_mutex_lock(&dq->lock);
+        if (dq->head < dq->tail)
         {
-            strncat(buf, " | ", n - strlen(buf) - 1);
+            *task = k == 0 ? dq->head++ : --dq->tail;
+            found = true;
         }
+        pthread_mutex_unlock(&dq->lock);
+
+        if (found)
+            return true;
     }
+    return false;
 }
 
-/**
- * print_validation_result - Pretty-print validation outcome with ANSI colors
- * @result: validation result to print (must not be NULL)
- *
- * When result->sql is set and a bad token is found, the original SQL string is
- * printed with a caret (^) pointing to the start of the offending token so the
- * user can immediately see which part of the query is wrong.
- */
-void print_validation_result(const ValidationResult* result)
+static void batch_run_task(BatchPool* pool, BatchTask* task, RunStats* stats)
 {
-    assert(result != NULL);
-
-    if (result->ok)
+    for (size_t i = 0; i < task->count; i++)
     {
-        printf(CLR_GRN "validation: ok" CLR_RESET "\n");
-        return;
+        size_t index = task->first + i;
+        if (!run_statement(&task->out,
+                           pool->opt,
+                           index + 1,
+                           pool->buf,
+                           pool->stmts[index],
+                           stats))
+            task->failed++;
     }
+}
 
-    const ValidationError* e0 = &result->errors[0];
-    char tokbuf[128];
-    char namebuf[64];
-    char expectedbuf[256];
-    describe_token(e0, tokbuf, sizeof(tokbuf));
-    token_name(e0, namebuf, sizeof(namebuf));
-    expected_to_str(e0->expected, expectedbuf, sizeof(expectedbuf));
-
-    printf(CLR_RED "validation failed" CLR_RESET " at token %s: expected %s, "
-                   "got %s%s%s",
-           namebuf,
-           expectedbuf,
-           CLR_YEL,
-           tokbuf,
-           CLR_RESET);
-    if (e0->message && e0->message[0])
-        printf(" (%s)", e0->message);
-
-    if (result->error_count > 1)
-        printf(" [and %zu more]", result->error_count - 1);
-
-    printf("\n");
-
-    /* Show the original SQL with a caret pointing at the bad token */
-    if (result->sql && e0->token && e0->token->value)
-    {
-        const char* sql = result->sql;
-        int offset      = e0->token->pos;
-        int val_len     = (int)strlen(e0->token->value);
-
-        printf("  %s\n", sql);
-        printf("  ");
-        for (int i = 0; i < offset; i++)
-            printf(" ");
-        printf(CLR_RED);
-        for (int i = 0; i < val_len; i++)
-            printf("^");
-        printf(CLR_RESET "\n");
-    }
-    else if (result->sql && !e0->token)
+static void* batch_worker(void* arg)
+{
+    BatchWorker* w  = arg;
+    BatchPool* pool = w->pool;
+    RunStats* stats = pool->stats ? &pool->stats[w->id] : NULL;
+
+    size_t t;
+    while (batch_take(pool, w->id, &t))
     {
-        /* EOF error: point past the end of the SQL */
-        const char* sql = result->sql;
-        size_t sql_len  = strlen(sql);
-        printf("  %s\n", sql);
-        printf("  ");
-        for (size_t i = 0; i < sql_len; i++)
-            printf(" ");
-        printf(CLR_RED "^" CLR_RESET " (unerwartetes Ende)\n");
+        batch_run_task(pool, &pool->tasks[t], stats);
+
+        pthread_mutex_lock(&pool->done_lock);
+        pool->tasks[t].done = true;
+        pthread_cond_broadcast(&pool->done_cond);
+        pthread_mutex_unlock(&pool->done_lock);
     }
-}
 
-// NOTE: for developing tests and triggering treesitter to highlight
-//<-- test dev-->
-// #define TEST_MODE false
-// #if TEST_MODE
-//<-- test dev-->
+    return NULL;
+}
 
-#ifndef TEST_MODE
 /**
- * main - Program entry point: tokenizes and validates a SQL string
- * @argc: number of command-line arguments
- * @argv: argument vector; argv[1] is the SQL string to validate
+ * run_batch_parallel - Validate statements on a pool of worker threads
+ * @buf: input buffer
+ * @stmts: statement ranges inside @buf, in input order
+ * @count: number of entries in @stmts
+ * @jobs: number of worker threads
+ * @opt: passed on to run_statement()
+ * @out: output
+ * @failed: receives the number of failed statements
+ * @report: receives the --stats counters of every worker, or NULL
  *
- * When invoked with exactly one argument the SQL is tokenized and validated.
- * A human-readable result is printed to stdout. The exit code is always 0
- * so that the program can be used as a diagnostic tool in scripts.
+ * Prints the same output as the sequential batch loop, in input order.
  *
- * Return: 0 always (use the printed diagnostic for pass/fail information)
+ * Return: 0 on success, 2 if threads or output buffers could not be created.
  */
-int main(int argc, char* argv[])
+static int run_batch_parallel(const char* buf,
+                              const scanql_span* stmts,
+                              size_t count,
+                              size_t jobs,
+                              const RunOptions* opt,
+                              Writer* out,
+                              size_t* failed,
+                              StatsReport* report)
 {
-    const char* sql;
+    /* Group statements into tasks; a huge statement becomes its own task */
+    BatchTask* tasks = calloc(count ? count : 1, sizeof(BatchTask));
+    if (!tasks)
+        return 2;
 
-    if (argc == 2)
+    size_t ntasks = 0;
+    for (size_t i = 0; i < count;)
     {
-        sql = argv[1];
+        BatchTask* task = &tasks[ntasks++];
+        size_t bytes    = 0;
+        task->first     = i;
+        while (i < count && task->count < BATCH_TASK_STATEMENTS &&
+               bytes < BATCH_TASK_BYTES)
+        {
+            bytes += stmts[i++].length;
+            task->count++;
+        }
     }
-    else
+
+    if (jobs > ntasks)
+        jobs = ntasks ? ntasks : 1;
+
+    BatchPool pool = {
+        .buf     = buf,
+        .stmts   = stmts,
+        .tasks   = tasks,
+        .workers = jobs,
+        .opt     = opt,
+    };
+    pool.deques          = calloc(jobs, sizeof(TaskDeque));
+    pthread_t* threads   = calloc(jobs, sizeof(pthread_t));
+    BatchWorker* workers = calloc(jobs, sizeof(BatchWorker));
+    bool stats_oom       = false;
+    if (report && (pool.stats = calloc(jobs, sizeof(RunStats))) != NULL)
     {
-        /* Fallback demo query when no argument is provided */
-        sql = "SELECT a, b FROM c WHERE id = 1;";
+        for (size_t w = 0; w < jobs; w++)
+            stats_oom |= !(pool.stats[w].profile = scanql_profile_new());
+    }
+    if (!pool.deques || !threads || !workers || (report && !pool.stats) ||
+        stats_oom)
+    {
+        for (size_t w = 0; pool.stats && w < jobs; w++)
+            scanql_profile_free(pool.stats[w].profile);
+        free(pool.stats);
+        free(workers);
+        free(threads);
+        free(pool.deques);
+        free(tasks);
+        return 2;
     }
 
-    size_t txt_len = strlen(sql);
+    pthread_mutex_init(&pool.done_lock, NULL);
+    pthread_cond_init(&pool.done_cond, NULL);
+    for (size_t w = 0; w < jobs; w++)
+    {
+        pthread_mutex_init(&pool.deques[w].lock, NULL);
+        pool.deques[w].head = ntasks * w / jobs;
+        pool.deques[w].tail = ntasks * (w + 1) / jobs;
+    }
 
-    Arena arena = init_static_arena(2 * txt_len + 16 + txt_len * sizeof(Token));
-    TokenStack tokenList = get_tokens(sql, &arena);
+    size_t started = 0;
+    for (; started < jobs; started++)
+    {
+        workers[started] = (BatchWorker){.pool = &pool, .id = started};
+        if (pthread_create(
+                &threads[started], NULL, batch_worker, &workers[started]) != 0)
+            break;
+    }
 
-    /* Validate produced tokens */
-    ValidationError errs[tokenList.len + 2];
-    ValidationResult res = {
-        .ok             = true,
-        .error_count    = 0,
-        .error_capacity = sizeof(errs) / sizeof(errs[0]),
-        .errors         = errs,
-        .sql            = sql,
-    };
+    /* Worker 0's slice is always taken by someone once a thread runs */
+    if (started == 0)
+        batch_worker(&workers[0]);
 
-    validate_query_with_errors(&tokenList, &res);
-    print_validation_result(&res);
+    bool error = false;
+    *failed    = 0;
+    for (size_t t = 0; t < ntasks; t++)
+    {
+        pthread_mutex_lock(&pool.done_lock);
+        while (!tasks[t].done)
+            pthread_cond_wait(&pool.done_cond, &pool.done_lock);
+        pthread_mutex_unlock(&pool.done_lock);
+
+        uint64_t t0 = report ? now_ns() : 0;
+        writer_put(out, tasks[t].out.data, tasks[t].out.len);
+        if (report)
+            report->output_ns += now_ns() - t0;
+        free(tasks[t].out.data);
+        error |= tasks[t].out.error;
+        *failed += tasks[t].failed;
+    }
 
-    arena_free(&arena);
+    for (size_t w = 0; w < started; w++)
+        pthread_join(threads[w], NULL);
+    for (size_t w = 0; w < jobs; w++)
+        pthread_mutex_destroy(&pool.deques[w].lock);
+    pthread_cond_destroy(&pool.done_cond);
+    pthread_mutex_destroy(&pool.done_lock);
 
-    return res.ok ? 0 : 1;
+    for (size_t w = 0; pool.stats && w < jobs; w++)
+    {
+        stats_merge(report, &pool.stats[w]);
+        scanql_profile_free(pool.stats[w].profile);
+    }
+    free(pool.stats);
+    free(workers);
+    free(threads);
+    free(pool.deques);
+    free(tasks);
+    return error ? 2 : 0;
 }
-#else
 
-/**
- * make_stack - Wrap a Token array into a read-only TokenStack view
- * @toks: array of tokens
- * @len: number of elements in @toks
- *
- * Return: TokenStack pointing into the caller's array (no allocation).
- */
-static TokenStack make_stack(Token* toks, int len)
-{
-    TokenStack s = {.elems = toks, .len = len, .cap = len};
-    return s;
-}
+/* Upper bound for --jobs; more threads than this only cost memory */
+#define JOBS_MAX 1024
 
-/**
- * make_token - Construct a Token with given value and type
- * @val: lexeme string (must outlive the token)
- * @type: SqlSymbols type tag
- *
- * Return: initialized Token.
- */
-static Token make_token(const char* val, SqlSymbols type)
+/* Number of online CPUs, at least 1 and at most JOBS_MAX. */
+static size_t online_cpus(void)
 {
-    Token t = {.value = (char*)val, .type = type};
-    return t;
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > JOBS_MAX)
+        return JOBS_MAX;
+    return n > 0 ? (size_t)n : 1;
 }
 
-/**
- * test_append_increments_len_until_capacity - append fills the stack in order
+/*
+ * collect_statements - Split a whole buffer into statement ranges up front
+ *
+ * Return: malloc'd array (NULL when empty or out of memory, see @count).
  */
-static void test_append_increments_len_until_capacity(void)
+static scanql_span* collect_statements(const char* buf,
+                                       size_t len,
+                                       size_t* count,
+                                       bool* oom)
 {
-    Token buf[3];
-    TokenStack s = {.elems = buf, .len = 0, .cap = 3};
-
-    append(&s, make_token("a", SQL_IDENTIFIER));
-    append(&s, make_token("b", SQL_IDENTIFIER));
-    append(&s, make_token("c", SQL_IDENTIFIER));
-
-    assert(s.len == 3);
-    assert(strcmp(s.elems[0].value, "a") == 0);
-    assert(strcmp(s.elems[1].value, "b") == 0);
-    assert(strcmp(s.elems[2].value, "c") == 0);
+    scanql_span* stmts = NULL;
+    size_t cap         = 0;
+    size_t cursor      = 0;
+    scanql_span stmt;
+
+    *count = 0;
+    *oom   = false;
+    while (scanql_next_statement(buf, len, &cursor, &stmt))
+    {
+        if (*count == cap)
+        {
+            size_t grown_cap   = cap ? cap * 2 : 1024;
+            scanql_span* grown = realloc(stmts, grown_cap * sizeof(*stmts));
+            if (!grown)
+            {
+                free(stmts);
+                *oom = true;
+                return NULL;
+            }
+            stmts = grown;
+            cap   = grown_cap;
+        }
+        stmts[(*count)++] = stmt;
+    }
+    return stmts;
 }
 
 /**
- * test_append_does_not_overflow_capacity - append beyond capacity is silently
- * ignored
+ * run_batch - Validate every statement of a file (or stdin for "-")
+ * @path: file to read, "-" for stdin
+ * @jobs: worker threads; 1 validates in the calling thread
+ * @opt: passed on to run_statement()
+ * @out: output
+ * @report: receives --stats counters, or NULL
+ *
+ * The input is split at semicolons outside of quotes and each statement is
+ * validated in this process.
+ * With @jobs > 1 the statements are spread over a thread pool, see
+ * run_batch_parallel(). One result is printed per statement, in input
+ * order, and FORMAT_TEXT adds a total.
+ *
+ * Return: 0 if all statements are valid, 1 if any failed, 2 on I/O errors.
  */
-static void test_append_does_not_overflow_capacity(void)
+static int run_batch(const char* path,
+                     size_t jobs,
+                     const RunOptions* opt,
+                     Writer* out,
+                     StatsReport* report)
 {
-    Token buf[2];
-    TokenStack s = {.elems = buf, .len = 0, .cap = 2};
+    Input input;
+    if (!load_input(path, opt->populate, &input))
+        return 2;
+    const char* buf = input.data;
+    size_t len      = input.len;
+
+    /* Errors are reported by line; the index is only built on the first */
+    RunOptions in  = *opt;
+    in.lines       = scanql_lines_new(buf, len);
+    opt            = &in;
+    size_t total   = 0;
+    size_t failed  = 0;
+    uint64_t start = report ? now_ns() : 0;
+
+    /*
+     * Dumps repeat few statement shapes. Unless only the first error is
+     * wanted, the error counts of failing shapes come from a verdict cache;
+     * without one statements are validated as usual.
+     */
+    if (in.max_errors != 1)
+        in.cache = scanql_cache_new(BATCH_CACHE_ENTRIES);
+
+    if (jobs > 1)
+    {
+        bool oom           = false;
+        scanql_span* stmts = collect_statements(buf, len, &total, &oom);
+        int rc             = oom ? 2
+                                 : run_batch_parallel(buf,
+                                                      stmts,
+                                                      total,
+                                                      jobs,
+                                                      opt,
+                                                      out,
+                                                      &failed,
+                                                      report);
+        free(stmts);
+        if (rc != 0)
+        {
+            fprintf(stderr, "%s: out of memory or threads\n", path);
+            scanql_lines_free(in.lines);
+            scanql_cache_free(in.cache);
+            input_free(&input);
+            return rc;
+        }
+    }
+    else
+    {
+        RunStats rs    = {.profile = report ? scanql_profile_new() : NULL};
+        RunStats* mine = rs.profile ? &rs : NULL;
+        if (report && !mine)
+        {
+            fprintf(stderr, "%s: out of memory\n", path);
+            scanql_lines_free(in.lines);
+            scanql_cache_free(in.cache);
+            input_free(&input);
+            return 2;
+        }
 
-    append(&s, make_token("x", SQL_IDENTIFIER));
-    append(&s, make_token("y", SQL_IDENTIFIER));
-    /* This should be ignored because len == cap */
-    append(&s, make_token("z", SQL_IDENTIFIER));
+        size_t cursor = 0;
+        scanql_span stmt;
+        while (scanql_next_statement(buf, len, &cursor, &stmt))
+        {
+            if (!run_statement(out, opt, ++total, buf, stmt, mine))
+                failed++;
+        }
 
-    assert(s.len == 2);
-    assert(strcmp(s.elems[0].value, "x") == 0);
-    assert(strcmp(s.elems[1].value, "y") == 0);
-}
+        if (mine)
+        {
+            stats_merge(report, mine);
+            scanql_profile_free(rs.profile);
+        }
+    }
 
-/**
- * test_append_null_stack_is_safe - append to NULL stack must not crash
- */
-static void test_append_null_stack_is_safe(void)
-{
-    append(NULL, make_token("x", SQL_IDENTIFIER));
+    if (opt->format == FORMAT_TEXT)
+        writer_printf(out,
+                      "total: %zu statements, %zu ok, %zu failed\n",
+                      total,
+                      total - failed,
+                      failed);
+    writer_flush(out);
+    if (report)
+        report->wall_ns = now_ns() - start;
+
+    scanql_lines_free(in.lines);
+    scanql_cache_free(in.cache);
+    input_free(&input);
+
+    return failed ? 1 : 0;
 }
 
-/**
- * test_report_formats_errors - smoke-test that the printer handles a real error
- * result without crashing and renders at least one error line.
- */
-static void test_report_formats_errors(void)
+/* State shared with the --stream callback. */
+typedef struct
 {
-    Token toks[] = {
-        {.value = "FROM", .type = FROM}, /* invalid start */
-        {.value = "SELECT", .type = SELECT},
-        {.value = "FROM", .type = FROM},
-        {.value = "t", .type = SQL_IDENTIFIER},
-        {.value = ";", .type = SEMICOLON},
-    };
-    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
-
-    ValidationError errs[8];
-    ValidationResult res = {.errors = errs, .error_capacity = 8};
-    bool ok              = validate_query_with_errors(&s, &res);
-
-    assert(!ok);
-    assert(res.error_count >= 1);
+    const RunOptions* opt;
+    Writer* out;
+    size_t total;
+    size_t failed;
+} StreamRun;
 
-    /* Smoke-test the printer (no assertions on stdout content) */
-    print_validation_result(&res);
-}
-
-/**
- * test_report_formats_new_symbols - smoke-test that symbol_to_str covers
- * every token type reachable from the current enum (UPDATE, JOIN, etc.).
- */
-static void test_report_formats_new_symbols(void)
+static void print_stream_result(const scanql_statement* stmt, void* user)
 {
-    /* Manually craft a result using newly added symbols to exercise
-     * symbol_to_str */
-    ValidationError errs[2];
-    errs[0].token    = &(Token){.value = "UPDATE", .type = UPDATE};
-    errs[0].position = 0;
-    errs[0].expected = (Valid_Symbols){{SELECT}, 1}; /* arbitrary state */
-    errs[0].message  = "unexpected token";
-
-    errs[1].token    = &(Token){.value = "JOIN", .type = JOIN};
-    errs[1].position = 1;
-    errs[1].expected = (Valid_Symbols){{SQL_IDENTIFIER}, 1};
-    errs[1].message  = "unexpected token";
-
-    ValidationResult res = {
-        .ok             = false,
-        .error_count    = 2,
-        .error_capacity = 2,
-        .errors         = errs,
-    };
-
-    /* Smoke-test that printer handles new enum entries without falling back to
-     * '?' */
-    print_validation_result(&res);
+    StreamRun* run = user;
+    run->total++;
+    if (!stmt->result.ok)
+        run->failed++;
+
+    /* emit_result() wants the error offset relative to the statement */
+    scanql_result res = stmt->result;
+    if (!res.ok)
+        res.error.offset -= stmt->span.offset;
+
+    /* The source bytes are gone by now; report the token type and offset */
+    emit_result(run->out, run->opt, stmt->index, NULL, stmt->span, &res);
+    if (!res.ok && run->opt->format == FORMAT_TEXT)
+        writer_printf(run->out, "  at byte %zu\n", stmt->result.error.offset);
 }
 
 /**
- * test_valid_simple_select_star - Validate SELECT *,identifier FROM
+ * run_stream - Validate stdin chunk by chunk as it arrives
+ *
+ * @opt: output format
+ * @out: output
+ *
+ * Uses the push-style scanql_stream, so a verdict is printed as soon as a
+ * statement's ';' has been read and memory use does not depend on the input
+ * size.
+ *
+ * Return: 0 if all statements are valid, 1 if any failed, 2 on read errors.
  */
-static void test_valid_simple_select_star(void)
+static int run_stream(const RunOptions* opt, Writer* out)
 {
-    Token toks[] = {
-        {.value = "SELECT", .type = SELECT},
-        {.value = "*", .type = STAR},
-        {.value = ",", .type = COMMA},
-        {.value = "a", .type = SQL_IDENTIFIER},
-        {.value = "FROM", .type = FROM},
-        {.value = "t", .type = SQL_IDENTIFIER},
-        {.value = ";", .type = SEMICOLON},
-    };
-    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
-    assert(validate_query(&s));
-}
+    StreamRun run         = {.opt = opt, .out = out};
+    scanql_stream* stream = scanql_stream_new(print_stream_result, &run);
+    if (!stream)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
 
-/**
- * test_valid_where_and_or - Validate WHERE with AND/OR chain
- */
-static void test_valid_where_and_or(void)
-{
-    Token toks[] = {
-        {.value = "SELECT", .type = SELECT},
-        {.value = "name", .type = SQL_IDENTIFIER},
-        {.value = "FROM", .type = FROM},
-        {.value = "users", .type = SQL_IDENTIFIER},
-        {.value = "WHERE", .type = WHERE},
-        {.value = "name", .type = SQL_IDENTIFIER},
-        {.value = "=", .type = EQUALS},
-        {.value = "'nick'", .type = SINGLE_QUOTED_VALUE},
-        {.value = "AND", .type = AND},
-        {.value = "age", .type = SQL_IDENTIFIER},
-        {.value = "=", .type = EQUALS},
-        {.value = "42", .type = NUMBER},
-        {.value = ";", .type = SEMICOLON},
-    };
-    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
-    assert(validate_query(&s));
+    char chunk[64 * 1024];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), stdin)) > 0)
+    {
+        scanql_stream_feed(stream, chunk, n);
+        writer_flush(out);
+    }
+    if (ferror(stdin))
+    {
+        fprintf(stderr, "stdin: read error\n");
+        scanql_stream_free(stream);
+        return 2;
+    }
+    scanql_stream_finish(stream);
+    scanql_stream_free(stream);
+
+    if (opt->format == FORMAT_TEXT)
+        writer_printf(out,
+                      "total: %zu statements, %zu ok, %zu failed\n",
+                      run.total,
+                      run.total - run.failed,
+                      run.failed);
+    writer_flush(out);
+
+    return run.failed ? 1 : 0;
 }
 
 /**
- * test_invalid_missing_from - Ensure missing FROM is rejected
+ * run_normalize - Print the template of every statement in a file
+ * @path: file to read, or "-" for stdin
+ * @populate: passed on to load_input()
+ * @out: output
+ *
+ * Prints one line per statement: the template ID in hex and the normalized
+ * text, so that logged statements can be grouped with sort and uniq.
+ *
+ * Return: 0 on success, 2 on I/O errors.
  */
-static void test_invalid_missing_from(void)
+static int run_normalize(const char* path, bool populate, Writer* out)
 {
-    Token toks[] = {
-        {.value = "SELECT", .type = SELECT},
-        {.value = "a", .type = SQL_IDENTIFIER},
-        {.value = "t", .type = SQL_IDENTIFIER},
-        {.value = ";", .type = SEMICOLON},
-    };
-    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
-    ValidationError errs[8];
-    ValidationResult res = {.errors = errs, .error_capacity = 8};
-    assert(!validate_query_with_errors(&s, &res));
-    assert(res.error_count >= 1);
-}
+    Input input;
+    if (!load_input(path, populate, &input))
+        return 2;
+    const char* buf = input.data;
+    size_t len      = input.len;
+
+    size_t cap = 4096;
+    char* text = malloc(cap);
+    int rc     = text ? 0 : 2;
+
+    size_t cursor = 0;
+    scanql_span stmt;
+    while (rc == 0 && scanql_next_statement(buf, len, &cursor, &stmt))
+    {
+        const char* sql = buf + stmt.offset;
+        scanql_template tpl;
+        scanql_normalize(sql, stmt.length, text, cap, &tpl);
+        if (tpl.length >= cap)
+        {
+            char* grown = realloc(text, tpl.length + 1);
+            if (!grown)
+            {
+                rc = 2;
+                break;
+            }
+            text = grown;
+            cap  = tpl.length + 1;
+            scanql_normalize(sql, stmt.length, text, cap, &tpl);
+        }
+        writer_printf(out, "%016" PRIx64 " ", tpl.id);
+        writer_put(out, text, tpl.length);
+        writer_put(out, "\n", 1);
+    }
 
-/**
- * test_invalid_trailing_after_semicolon - Ensure trailing tokens after ';' fail
- */
-static void test_invalid_trailing_after_semicolon(void)
-{
-    Token toks[] = {
-        {.value = "SELECT", .type = SELECT},
-        {.value = "a", .type = SQL_IDENTIFIER},
-        {.value = "FROM", .type = FROM},
-        {.value = "t", .type = SQL_IDENTIFIER},
-        {.value = ";", .type = SEMICOLON},
-        {.value = "DROP", .type = SQL_IDENTIFIER},
-    };
-    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
-    ValidationError errs[8];
-    ValidationResult res = {.errors = errs, .error_capacity = 8};
-    assert(!validate_query_with_errors(&s, &res));
-    assert(res.error_count >= 1);
+    if (rc != 0)
+        fprintf(stderr, "%s: out of memory\n", path);
+    free(text);
+    input_free(&input);
+    return rc;
 }
 
-/**
- * test_accumulates_multiple_errors - Ensure multiple mismatches are collected
- */
-static void test_accumulates_multiple_errors(void)
+/* Parse a non-negative decimal count; false if @s is not one or too large. */
+static bool parse_count(const char* s, size_t* count)
 {
-    Token toks[] = {
-        {.value = "FROM", .type = FROM}, /* wrong start */
-        {.value = "SELECT", .type = SELECT},
-        {.value = "FROM", .type = FROM}, /* missing select item before FROM */
-        {.value = "t", .type = SQL_IDENTIFIER},
-        {.value = "WHERE", .type = WHERE},
-        {.value = "=", .type = EQUALS}, /* missing lhs */
-        {.value = "1", .type = NUMBER},
-        {.value = ";", .type = SEMICOLON},
-    };
-    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
-    ValidationError errs[16];
-    ValidationResult res = {.errors = errs, .error_capacity = 16};
-    bool ok              = validate_query_with_errors(&s, &res);
-    assert(!ok);
-    assert(res.error_count >= 2);
+    char* end;
+    errno                = 0;
+    unsigned long long n = strtoull(s, &end, 10);
+    if (*s == '\0' || *s == '-' || *end != '\0' || errno == ERANGE ||
+        n > SIZE_MAX)
+        return false;
+    *count = (size_t)n;
+    return true;
 }
 
-/**
- * test_invalid_token_aborts_early - Invalid lexeme should halt validation
- */
-static void test_invalid_token_aborts_early(void)
+/* Parse a --format value; false if @s names no format. */
+static bool parse_format(const char* s, OutputFormat* format)
 {
-    Token toks[] = {
-        {.value = "SELECT", .type = SELECT},
-        {.value = "a", .type = SQL_IDENTIFIER},
-        {.value = "FROM", .type = FROM},
-        {.value = "t", .type = SQL_IDENTIFIER},
-        {.value = "(", .type = ROUND_BRACKETS_OPEN}, /* unsupported token */
-        {.value = ";", .type = SEMICOLON},
+    static const char* const names[] = {
+        [FORMAT_TEXT]  = "text",
+        [FORMAT_JSONL] = "jsonl",
+        [FORMAT_TSV]   = "tsv",
     };
-    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
-    ValidationError errs[8];
-    ValidationResult res = {.errors = errs, .error_capacity = 8};
-    bool ok              = validate_query_with_errors(&s, &res);
-
-    assert(!ok);
-    assert(res.error_count >= 1);
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (strcmp(s, names[i]) == 0)
+        {
+            *format = (OutputFormat)i;
+            return true;
+        }
+    }
+    return false;
 }
 
 /**
- * test_invalid_new_keyword_token - Newly added keyword should also be rejected
- * by validator
+ * main - Program entry point: tokenizes and validates SQL
+ * @argc: number of command-line arguments
+ * @argv: argument vector
+ *
+ * Usage:
+ *   scanql <SQL-String>       validate a single statement
+ *   scanql --file <path|->    validate every statement in a file or stdin
+ *          [--jobs <n>]       ... on n threads (0: one per online CPU,
+ *                             at most JOBS_MAX)
+ *   scanql --normalize --file <path|->
+ *                             print the template of every statement
+ *   scanql --stream           validate stdin incrementally as it arrives
+ *   scanql --serve <path>     answer requests on a Unix domain socket
+ *          [--jobs <n>]       ... on n worker threads (default: one per CPU)
+ *
+ * --max-errors <n> limits the errors looked for in a failing statement;
+ * 1 stops at the first one. The default 0 finds all of them. --serve always
+ * stops at the first error, see serve.c for its protocol.
+ *
+ * --stats[=json] validates a statement or --file with lexing and validation
+ * timed apart and prints counters to stderr once done, see print_stats().
+ *
+ * --format=text|jsonl|tsv picks how verdicts are printed, see emit_result().
+ * Text is colored when stdout is a terminal.
+ *
+ * --populate prefaults the whole --file up front instead of paging it in
+ * as the validation reaches it, see map_input().
+ *
+ * Without arguments a built-in demo query is validated. A human-readable
+ * result is printed to stdout.
+ *
+ * Return: 0 if everything is valid, 1 on validation failures, 2 on usage or
+ * I/O errors.
  */
-static void test_invalid_new_keyword_token(void)
+int main(int argc, char* argv[])
 {
-    Token toks[] = {
-        {.value = "UPDATE", .type = UPDATE}, /* not supported by validator */
-        {.value = "t", .type = SQL_IDENTIFIER},
-        {.value = "SET", .type = SET},
-        {.value = "a", .type = SQL_IDENTIFIER},
-        {.value = "=", .type = EQUALS},
-        {.value = "1", .type = NUMBER},
-        {.value = ";", .type = SEMICOLON},
-    };
-    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
-    ValidationError errs[8];
-    ValidationResult res = {.errors = errs, .error_capacity = 8};
-    bool ok              = validate_query_with_errors(&s, &res);
+    const char* sql   = NULL;
+    const char* file  = NULL;
+    const char* serve = NULL;
+    bool stream       = false;
+    bool normalize    = false;
+    bool stats        = false;
+    bool stats_json   = false;
+    bool populate     = false;
+    bool format_given = false;
+    OutputFormat fmt  = FORMAT_TEXT;
+    bool jobs_given   = false;
+    size_t jobs       = 1;
+    size_t max_errors = 0;
+    bool usage        = true;
+
+    for (int i = 1; i < argc && usage; i++)
+    {
+        const char* arg = argv[i];
+        bool has_value  = i + 1 < argc;
+
+        if (strcmp(arg, "--file") == 0 && has_value)
+            file = argv[++i];
+        else if (strcmp(arg, "--jobs") == 0 && has_value)
+            usage = jobs_given =
+                parse_count(argv[++i], &jobs) && jobs <= JOBS_MAX;
+        else if (strcmp(arg, "--max-errors") == 0 && has_value)
+            usage = parse_count(argv[++i], &max_errors);
+        else if (strcmp(arg, "--serve") == 0 && has_value)
+            serve = argv[++i];
+        else if (strcmp(arg, "--normalize") == 0)
+            normalize = true;
+        else if (strcmp(arg, "--stream") == 0)
+            stream = true;
+        else if (strcmp(arg, "--populate") == 0)
+            populate = true;
+        else if (strcmp(arg, "--stats") == 0 ||
+                 strcmp(arg, "--stats=text") == 0)
+            stats = true;
+        else if (strcmp(arg, "--stats=json") == 0)
+            stats = stats_json = true;
+        else if (strncmp(arg, "--format=", 9) == 0)
+            usage = format_given = parse_format(arg + 9, &fmt);
+        else if (!sql && strncmp(arg, "--", 2) != 0)
+            sql = arg;
+        else
+            usage = false;
+    }
 
-    assert(ok); // Now UPDATE is supported, so it should be valid
-}
+    /* Exactly one input; --jobs only applies to --file and --serve */
+    if ((sql != NULL) + (file != NULL) + (serve != NULL) + stream > 1 ||
+        (jobs_given && !file && !serve) || (max_errors && serve) ||
+        (normalize && (!file || jobs_given || max_errors)) ||
+        (stats && (stream || serve || normalize)) ||
+        (format_given && (serve || normalize)) || (populate && !file))
+        usage = false;
 
-/**
- * test_tokenizes_basic_select - Ensure tokenizer produces expected tokens
- */
-static void test_tokenizes_basic_select(void)
-{
-    const char* sql = "SELECT name,age FROM users;";
-    size_t sql_len  = strlen(sql);
-    Arena arena     = init_static_arena(sql_len * 2 + sql_len * sizeof(Token));
-    TokenStack toks = get_tokens(sql, &arena);
-
-    assert(toks.len == 7);
-    assert(toks.elems[0].type == SELECT);
-    assert(strcmp(toks.elems[1].value, "name") == 0);
-    assert(toks.elems[2].type == COMMA);
-    assert(strcmp(toks.elems[3].value, "age") == 0);
-    assert(toks.elems[4].type == FROM);
-    assert(strcmp(toks.elems[5].value, "users") == 0);
-    assert(toks.elems[6].type == SEMICOLON);
-
-    arena_free(&arena);
-}
+    if (!usage)
+    {
+        fprintf(stderr,
+                "usage: %s [options] <SQL-String>\n"
+                "       %s [options] [--jobs <n>] [--populate] "
+                "--file <path|->\n"
+                "       %s --normalize [--populate] --file <path|->\n"
+                "       %s [--format=<f>] --stream\n"
+                "       %s [--jobs <n>] --serve <socket-path>\n",
+                argv[0],
+                argv[0],
+                argv[0],
+                argv[0],
+                argv[0]);
+        fprintf(stderr,
+                "options: --max-errors <n>, --stats[=json], "
+                "--format=text|jsonl|tsv\n");
+        return 2;
+    }
 
-/**
- * test_tokenizer_integrates_with_validator - Tokenizer output is accepted by
- * validator
- */
-static void test_tokenizer_integrates_with_validator(void)
-{
-    const char* sql = "SELECT a FROM t;";
-    size_t sql_len  = strlen(sql);
-    Arena arena     = init_static_arena(sql_len * 2 + sql_len * sizeof(Token));
-    TokenStack toks = get_tokens(sql, &arena);
+    if (serve)
+        return run_serve(serve, jobs_given && jobs ? jobs : online_cpus());
 
-    ValidationError errs[8];
-    ValidationResult res = {.errors = errs, .error_capacity = 8};
-    bool ok              = validate_query_with_errors(&toks, &res);
+    /* The Writer does all the buffering */
+    setvbuf(stdout, NULL, _IONBF, 0);
+    Writer out = {.fp = stdout, .data = malloc(WRITER_CAPACITY)};
+    out.cap    = out.data ? WRITER_CAPACITY : 0;
 
-    assert(ok);
+    RunOptions opt = {
+        .max_errors  = max_errors,
+        .format      = fmt,
+        .print_flags = isatty(STDOUT_FILENO) ? SCANQL_PRINT_COLOR : 0,
+        .populate    = populate,
+    };
+    StatsReport report = {0};
+    int rc             = 0;
+
+    if (file && normalize)
+        rc = run_normalize(file, populate, &out);
+    else if (file)
+        rc = run_batch(file,
+                       jobs ? jobs : online_cpus(),
+                       &opt,
+                       &out,
+                       stats ? &report : NULL);
+    else if (stream)
+        rc = run_stream(&opt, &out);
+    else
+    {
+        /* Fallback demo query when no argument is provided */
+        if (!sql)
+            sql = "SELECT a, b FROM c WHERE id = 1;";
 
-    arena_free(&arena);
-}
+        RunStats rs = {.profile = stats ? scanql_profile_new() : NULL};
+        if (stats && !rs.profile)
+        {
+            fprintf(stderr, "out of memory\n");
+            free(out.data);
+            return 2;
+        }
 
-/**
- * main - Run all unit tests for SqlValidateReport
- */
-int main(void)
-{
-    { // tokenizer
-        test_tokenizes_basic_select();
-        test_tokenizer_integrates_with_validator();
-    }
+        uint64_t start   = stats ? now_ns() : 0;
+        scanql_span span = {.offset = 0, .length = strlen(sql)};
+        RunStats* mine   = rs.profile ? &rs : NULL;
+        opt.lines        = scanql_lines_new(sql, span.length);
+        rc = run_statement(&out, &opt, 0, sql, span, mine) ? 0 : 1;
+        writer_flush(&out);
+        scanql_lines_free(opt.lines);
 
-    { // token stack
-        test_append_increments_len_until_capacity();
-        test_append_does_not_overflow_capacity();
-        test_append_null_stack_is_safe();
+        if (rs.profile)
+        {
+            report.wall_ns = now_ns() - start;
+            stats_merge(&report, &rs);
+            scanql_profile_free(rs.profile);
+        }
     }
 
-    { // sql validate
-        test_valid_simple_select_star();
-        test_valid_where_and_or();
-        test_invalid_missing_from();
-        test_invalid_trailing_after_semicolon();
-        test_accumulates_multiple_errors();
-        test_invalid_token_aborts_early();
-        test_invalid_new_keyword_token();
+    writer_flush(&out);
+    free(out.data);
+    if (out.error && rc != 2)
+    {
+        fprintf(stderr, "stdout: write error\n");
+        rc = 2;
     }
 
-    { // sql validate report
-        test_report_formats_errors();
-        test_report_formats_new_symbols();
-    }
-    return 0;
+    /* Statements of a failed run may be missing; only report complete ones */
+    if (stats && rc != 2)
+        print_stats(stderr, &report, stats_json);
+    return rc;
 }
-#endif
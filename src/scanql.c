@@ -0,0 +1,5933 @@
+#define _DEFAULT_SOURCE // clock_gettime, MAP_ANONYMOUS
+
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "scanql.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SCANQL_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/*
+ * SqlToken - Enumeration of SQL token types
+ *
+ * Only the tokens needed for DML statement validation are included.
+ * Parser states live in grammar.txt, which is compiled into the
+ * grammar_next[] transition table.
+ */
+
+typedef enum : unsigned short
+{
+    SELECT,
+    FROM,
+    WHERE,
+    UPDATE,
+    DELETE,
+    INSERT,
+    INTO,
+    VALUES,
+    SET,
+    JOIN,
+    CREATE,
+    TABLE,
+
+    COMMA,
+    SEMICOLON,
+    EQUALS,
+    STAR,
+
+    NUMBER,
+    DOUBLE_QUOTED_VALUE,
+    SINGLE_QUOTED_VALUE,
+    SQL_IDENTIFIER,
+
+    AND,
+    OR,
+
+    ROUND_BRACKETS_OPEN,
+    ROUND_BRACKETS_CLOSE,
+
+    END
+} SqlSymbols;
+
+/*
+ * symbol_to_str - usage by indexing with enum value from SqlSymbols
+ */
+const char* symbol_to_str[] = {"SELECT",
+                               "FROM",
+                               "WHERE",
+                               "UPDATE",
+                               "DELETE",
+                               "INSERT",
+                               "INTO",
+                               "VALUES",
+                               "SET",
+                               "JOIN",
+                               "CREATE",
+                               "TABLE",
+
+                               "COMMA",
+                               "SEMICOLON",
+                               "EQUALS",
+                               "STAR",
+
+                               "NUMBER",
+                               "DOUBLE_QUOTED_VALUE",
+                               "SINGLE_QUOTED_VALUE",
+                               "SQL_IDENTIFIER",
+
+                               "AND",
+                               "OR",
+
+                               "ROUND_BRACKETS_OPEN",
+                               "ROUND_BRACKETS_CLOSE",
+
+                               "END"};
+
+/*
+ * Token - A view into the SQL source; the lexeme is sql[pos, pos + len) and
+ * is never copied.
+ */
+typedef struct
+{
+    SqlSymbols type;
+    size_t pos; // byte offset in the original SQL string
+    size_t len; // lexeme length in bytes
+} Token;
+
+void print_token(Token token, const char* sql)
+{
+    printf("Token { value: < %.*s >, type: %s}\n",
+           token.len < INT_MAX ? (int)token.len : INT_MAX,
+           sql + token.pos,
+           symbol_to_str[token.type]);
+}
+
+/**
+ * struct ArenaBlock - One block of an arena's chain
+ * @next: following block, kept across resets for reuse
+ * @size: bytes used in @data
+ * @capacity: bytes available in @data
+ * @mapped: block was allocated with mmap() instead of malloc()
+ * @data: block payload
+ */
+typedef struct ArenaBlock
+{
+    struct ArenaBlock* next;
+    size_t size;
+    size_t capacity;
+    bool mapped;
+    _Alignas(max_align_t) unsigned char data[];
+} ArenaBlock;
+
+/**
+ * struct Arena - Chained bump allocator used by the tokenizer
+ * @head: first block of the chain
+ * @current: block allocations are served from
+ * @used: bytes handed out since the last reset, including alignment padding
+ * @high_water: largest @used seen since the arena was created
+ * @capacity: total bytes available in all blocks
+ *
+ * A zero-initialised Arena is empty and valid. Allocations never move:
+ * when @current is full the arena continues in the next block of the chain,
+ * linking a new one if needed. Resetting rewinds to @head and keeps every
+ * block, so an arena reused across statements stops allocating once it has
+ * grown to the largest statement.
+ */
+typedef struct
+{
+    ArenaBlock* head;
+    ArenaBlock* current;
+    size_t used;
+    size_t high_water;
+    size_t capacity;
+} Arena;
+
+/**
+ * struct ArenaMark - Saved allocation position, see arena_mark()
+ */
+typedef struct
+{
+    ArenaBlock* block;
+    size_t size;
+    size_t used;
+} ArenaMark;
+
+/**
+ * struct TokenEpochs - Upper halves of an ascending column of 64-bit offsets
+ * @first: token index from which epoch 1, 2, ... applies; epoch k covers the
+ *         offsets [k << 32, (k + 1) << 32)
+ * @count: epochs entered after epoch 0
+ * @cap: entries @first can hold
+ *
+ * A column only ever moves to a later epoch, so one entry per 4 GiB of input
+ * is enough to restore the upper 32 bits of any offset.
+ */
+typedef struct
+{
+    size_t* first;
+    size_t count;
+    size_t cap;
+} TokenEpochs;
+
+/**
+ * struct TokenStack - Growable token stream, stored struct-of-arrays
+ * @types: SqlSymbols of every token, one byte each; all the validator reads
+ * @offsets: low 32 bits of the byte offset of every lexeme in the source
+ * @ends: low 32 bits of the offset one past every lexeme
+ * @offset_epochs: upper halves of @offsets
+ * @end_epochs: upper halves of @ends
+ * @len: number of tokens
+ * @cap: number of tokens the arrays can hold
+ * @arena: arena the arrays grow in when full; NULL for fixed storage
+ * @truncated: set once append() dropped a token for lack of memory
+ *
+ * A token costs 9 bytes instead of a padded struct, and validation streams
+ * through the dense @types array. Lexemes neither overlap nor go backwards,
+ * so starts and ends both ascend and keep only their low halves per token,
+ * even in inputs beyond 4 GiB. token_at() reassembles a Token view.
+ */
+typedef struct
+{
+    uint8_t* types;
+    uint32_t* offsets;
+    uint32_t* ends;
+    TokenEpochs offset_epochs;
+    TokenEpochs end_epochs;
+    size_t len;
+    size_t cap;
+    Arena* arena;
+    bool truncated;
+} TokenStack;
+
+#define TOKEN_STACK_BYTES (sizeof(uint8_t) + 2 * sizeof(uint32_t))
+#define TOKEN_STACK_MIN_CAP 64
+
+static_assert(END <= UINT8_MAX, "SqlSymbols must fit into TokenStack.types");
+
+/*
+ * Arena block sizes. The first block defaults to ARENA_MIN_BLOCK; every
+ * new block is at least as large as the whole chain before it, so the
+ * number of blocks grows with the log of the peak size. Blocks of
+ * ARENA_HUGE_BLOCK bytes and more are mapped directly and, where the kernel
+ * supports it, backed by transparent huge pages.
+ */
+#define ARENA_MIN_BLOCK ((size_t)64 * 1024)
+#define ARENA_HUGE_BLOCK ((size_t)2 * 1024 * 1024)
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+static ArenaBlock* arena_new_block(size_t capacity)
+{
+    size_t bytes      = sizeof(ArenaBlock) + capacity;
+    ArenaBlock* block = NULL;
+    bool mapped       = false;
+
+#ifdef MAP_ANONYMOUS
+    if (bytes >= ARENA_HUGE_BLOCK)
+    {
+        bytes      = (bytes + ARENA_HUGE_BLOCK - 1) & ~(ARENA_HUGE_BLOCK - 1);
+        void* addr = mmap(NULL,
+                          bytes,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS,
+                          -1,
+                          0);
+        if (addr != MAP_FAILED)
+        {
+#ifdef MADV_HUGEPAGE
+            madvise(addr, bytes, MADV_HUGEPAGE);
+#endif
+            block    = addr;
+            mapped   = true;
+            capacity = bytes - sizeof(ArenaBlock);
+        }
+    }
+#endif
+    if (!block)
+        block = malloc(bytes);
+    if (!block)
+        return NULL;
+
+    block->next     = NULL;
+    block->size     = 0;
+    block->capacity = capacity;
+    block->mapped   = mapped;
+    return block;
+}
+
+/**
+ * arena_init - Create an arena with a pre-sized first block
+ * @capacity: bytes for the first block, 0 for the default size
+ *
+ * Sizing is only a hint: the arena grows on demand either way.
+ *
+ * Return: initialized Arena; empty (but usable) if the allocation failed.
+ */
+Arena arena_init(size_t capacity)
+{
+    Arena a = {0};
+    a.head  = arena_new_block(capacity ? capacity : ARENA_MIN_BLOCK);
+    if (a.head)
+    {
+        a.current  = a.head;
+        a.capacity = a.head->capacity;
+    }
+    return a;
+}
+
+/**
+ * arena_alloc - Allocate a slice from the arena
+ * @arena: arena to allocate from
+ * @size: bytes requested
+ *
+ * Slices are aligned for any object type and stay valid until the arena is
+ * reset, rewound past them or freed.
+ *
+ * Return: pointer to allocated slice or NULL if out of memory.
+ */
+static void* arena_alloc(Arena* arena, size_t size)
+{
+    if (!arena)
+        return NULL;
+
+    ArenaBlock* block = arena->current;
+    size_t start      = 0;
+    if (block)
+        start = (block->size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    while (!block || start > block->capacity || size > block->capacity - start)
+    {
+        /* The rest of @block is skipped but counted as used */
+        if (block)
+            arena->used += block->capacity - block->size;
+
+        if (block && block->next)
+        {
+            block       = block->next;
+            block->size = 0;
+        }
+        else
+        {
+            size_t want = arena->capacity > ARENA_MIN_BLOCK ? arena->capacity
+                                                            : ARENA_MIN_BLOCK;
+            ArenaBlock* fresh = arena_new_block(size > want ? size : want);
+            if (!fresh)
+                return NULL;
+
+            if (block)
+                block->next = fresh;
+            else
+                arena->head = fresh;
+            arena->capacity += fresh->capacity;
+            block = fresh;
+        }
+        start = 0;
+    }
+
+    arena->current = block;
+    arena->used += start - block->size + size;
+    block->size = start + size;
+    if (arena->used > arena->high_water)
+        arena->high_water = arena->used;
+    return &block->data[start];
+}
+
+/**
+ * arena_free - Release arena backing memory
+ * @arena: arena to free
+ *
+ * The arena is empty afterwards and may be used again.
+ */
+void arena_free(Arena* arena)
+{
+    if (!arena)
+        return;
+
+    ArenaBlock* block = arena->head;
+    while (block)
+    {
+        ArenaBlock* next = block->next;
+#ifdef MAP_ANONYMOUS
+        if (block->mapped)
+            munmap(block, sizeof(ArenaBlock) + block->capacity);
+        else
+#endif
+            free(block);
+        block = next;
+    }
+    *arena = (Arena){0};
+}
+
+/**
+ * arena_reset - Drop all allocations but keep every block for reuse
+ * @arena: arena to reset
+ *
+ * O(1): later blocks are cleared lazily when allocation reaches them.
+ */
+void arena_reset(Arena* arena)
+{
+    if (!arena)
+        return;
+    arena->current = arena->head;
+    arena->used    = 0;
+    if (arena->head)
+        arena->head->size = 0;
+}
+
+/**
+ * arena_mark - Remember the current allocation position
+ * @arena: arena to query
+ *
+ * Return: mark to pass to arena_rewind().
+ */
+ArenaMark arena_mark(const Arena* arena)
+{
+    ArenaMark m = {
+        .block = arena->current,
+        .size  = arena->current ? arena->current->size : 0,
+        .used  = arena->used,
+    };
+    return m;
+}
+
+/**
+ * arena_rewind - Drop every allocation made after a mark, in O(1)
+ * @arena: arena to rewind
+ * @mark: position returned by arena_mark() on this arena since its last
+ *        reset
+ */
+void arena_rewind(Arena* arena, ArenaMark mark)
+{
+    if (!arena || !mark.block)
+    {
+        arena_reset(arena);
+        return;
+    }
+    arena->current       = mark.block;
+    arena->current->size = mark.size;
+    arena->used          = mark.used;
+}
+
+/**
+ * arena_capacity_for - Arena size needed to tokenize a SQL string
+ * @txt_len: length of the SQL string in bytes
+ *
+ * Return: bytes for the token arrays of a token per input byte, including
+ * the arrays left behind while growing; a sizing hint for arena_init().
+ */
+size_t arena_capacity_for(size_t txt_len)
+{
+    return 2 * (TOKEN_STACK_MIN_CAP + txt_len) * TOKEN_STACK_BYTES;
+}
+
+/**
+ * token_stack_init - Create an empty token stream that grows in an arena
+ * @arena: arena for the token arrays
+ *
+ * Return: empty TokenStack; nothing is allocated before the first append().
+ */
+TokenStack token_stack_init(Arena* arena)
+{
+    TokenStack s = {.len = 0, .cap = 0, .arena = arena};
+    return s;
+}
+
+/*
+ * Move the arrays into twice the space. The old arrays stay behind in the
+ * arena until it is reset, so growth costs at most the final size again.
+ */
+static bool token_stack_grow(TokenStack* list)
+{
+    if (!list->arena || list->cap > SIZE_MAX / 2 / TOKEN_STACK_BYTES)
+        return false;
+
+    size_t cap = list->cap ? list->cap * 2 : TOKEN_STACK_MIN_CAP;
+    unsigned char* data = arena_alloc(list->arena, cap * TOKEN_STACK_BYTES);
+    if (!data)
+        return false;
+
+    uint32_t* offsets = (uint32_t*)data;
+    uint32_t* ends    = offsets + cap;
+    uint8_t* types    = (uint8_t*)(ends + cap);
+    if (list->len > 0)
+    {
+        memcpy(offsets, list->offsets, list->len * sizeof(*offsets));
+        memcpy(ends, list->ends, list->len * sizeof(*ends));
+        memcpy(types, list->types, list->len * sizeof(*types));
+    }
+
+    list->offsets = offsets;
+    list->ends    = ends;
+    list->types   = types;
+    list->cap     = cap;
+    return true;
+}
+
+/*
+ * Enter the epochs up to the one of @offset, starting at token @index. Runs
+ * once per 4 GiB of input; a stack over fixed storage cannot grow its list.
+ */
+static bool token_epochs_enter(TokenEpochs* e,
+                               Arena* arena,
+                               size_t index,
+                               uint64_t offset)
+{
+    while (e->count < offset >> 32)
+    {
+        if (e->count == e->cap)
+        {
+            size_t cap    = e->cap ? e->cap * 2 : 8;
+            size_t* first = arena ? arena_alloc(arena, cap * sizeof(*first))
+                                  : NULL;
+            if (!first)
+                return false;
+            if (e->count > 0)
+                memcpy(first, e->first, e->count * sizeof(*first));
+            e->first = first;
+            e->cap   = cap;
+        }
+        e->first[e->count++] = index;
+    }
+    return true;
+}
+
+/* Upper 32 bits of the offset of token @i in the column of @e */
+static inline uint64_t token_epoch(const TokenEpochs* e, size_t i)
+{
+    uint64_t epoch = 0;
+    while (epoch < e->count && e->first[epoch] <= i)
+        epoch++;
+    return epoch << 32;
+}
+
+/**
+ * append - Append a Token to the TokenStack
+ * @list: Pointer to the TokenStack to append to
+ * @token: Token to append
+ *
+ * A full stack grows in its arena; a stack over fixed storage, or one whose
+ * arena is out of memory, drops the token and is marked truncated.
+ *
+ * Return: Nothing
+ */
+void append(TokenStack* list, Token token)
+{
+    if (!list)
+        return;
+    if (list->len == list->cap && !token_stack_grow(list))
+    {
+        list->truncated = true;
+        return;
+    }
+
+    /* Past 4 GiB: note where the upper halves of the offsets change */
+    uint64_t pos = token.pos;
+    uint64_t end = pos + token.len;
+    if ((pos >> 32 > list->offset_epochs.count &&
+         !token_epochs_enter(
+             &list->offset_epochs, list->arena, list->len, pos)) ||
+        (end >> 32 > list->end_epochs.count &&
+         !token_epochs_enter(&list->end_epochs, list->arena, list->len, end)))
+    {
+        list->truncated = true;
+        return;
+    }
+
+    list->types[list->len]   = (uint8_t)token.type;
+    list->offsets[list->len] = (uint32_t)pos;
+    list->ends[list->len]    = (uint32_t)end;
+    list->len += 1;
+}
+
+/**
+ * token_at - View one token of a TokenStack
+ * @list: token stream
+ * @i: token index, 0 <= @i < @list->len
+ *
+ * Return: the token's type, offset and length.
+ */
+static inline Token token_at(const TokenStack* list, size_t i)
+{
+    uint64_t pos = token_epoch(&list->offset_epochs, i) | list->offsets[i];
+    uint64_t end = token_epoch(&list->end_epochs, i) | list->ends[i];
+
+    Token t = {
+        .type = (SqlSymbols)list->types[i],
+        .pos  = (size_t)pos,
+        .len  = (size_t)(end - pos),
+    };
+    return t;
+}
+
+/**
+ * match - Case-insensitive exact string comparison
+ * @to_compare: the input bytes to test (not NUL-terminated)
+ * @to_compare_len: number of bytes in @to_compare
+ * @compare_to: the reference string to match against
+ *
+ * Return: true if both strings have equal length and identical characters
+ *         (ignoring case), false otherwise.
+ */
+bool match(const char* to_compare,
+           size_t to_compare_len,
+           const char* compare_to)
+{
+    size_t compare_to_len = strlen(compare_to);
+    if (to_compare_len == compare_to_len)
+    {
+        for (size_t i = 0; i < compare_to_len; i++)
+        {
+            if (toupper(to_compare[i]) != toupper(compare_to[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+typedef struct
+{
+    const char* value;
+    SqlSymbols type;
+} Keyword;
+
+/**
+ * struct KeywordSlot - One entry of the keyword perfect hash table
+ * @lower: lower-case keyword, zero-padded so it can be compared as two words
+ * @len: keyword length in bytes
+ * @type: token type the keyword maps to
+ */
+typedef struct
+{
+    char lower[16];
+    unsigned char len;
+    SqlSymbols type;
+} KeywordSlot;
+
+/*
+ * keywords.h is generated from keywords.txt by scripts/gen-keywords.py. It
+ * defines keywords[], keyword_count, keyword_slots[] and the KEYWORD_HASH_*
+ * multipliers used by keyword_hash().
+ */
+#include "keywords.h"
+
+static_assert(sizeof(keyword_slots[0].lower) == KEYWORD_MAX_LEN,
+              "KeywordSlot.lower must match the generator's KEYWORD_MAX_LEN");
+
+/**
+ * keyword_hash - Perfect hash of a lexeme into keyword_slots[]
+ * @s: lexeme bytes
+ * @len: lexeme length, at least 1
+ *
+ * Only the length and the first, second and last byte (case folded) are
+ * hashed. scripts/gen-keywords.py picks the multipliers so that every
+ * keyword gets its own slot.
+ *
+ * Return: slot index.
+ */
+static inline unsigned keyword_hash(const char* s, size_t len)
+{
+    unsigned first  = (unsigned char)s[0] | 0x20u;
+    unsigned second = (unsigned char)s[len > 1 ? 1 : 0] | 0x20u;
+    unsigned last   = (unsigned char)s[len - 1] | 0x20u;
+
+    return ((unsigned)len * KEYWORD_HASH_LEN_MUL +
+            first * KEYWORD_HASH_FIRST_MUL + second * KEYWORD_HASH_SECOND_MUL +
+            last * KEYWORD_HASH_LAST_MUL) &
+           (KEYWORD_SLOT_COUNT - 1);
+}
+
+/**
+ * lookup_keyword - Map a lexeme to its keyword token type in O(1)
+ * @s: lexeme bytes (not NUL-terminated)
+ * @len: lexeme length
+ * @type: receives the keyword type on success
+ *
+ * The candidate slot is compared eight bytes at a time. Keywords only contain
+ * [A-Z_], so OR-ing the input with the keyword's 0x20 bits folds the case of
+ * letters while '_' and the zero padding are compared exactly.
+ *
+ * Return: true if the lexeme is a keyword.
+ */
+bool lookup_keyword(const char* s, size_t len, SqlSymbols* type)
+{
+    if (len == 0 || len > KEYWORD_MAX_LEN)
+        return false;
+
+    const KeywordSlot* slot = &keyword_slots[keyword_hash(s, len)];
+    if (slot->len != len)
+        return false;
+
+    uint64_t in[2] = {0, 0};
+    uint64_t kw[2];
+    memcpy(in, s, len);
+    memcpy(kw, slot->lower, sizeof(kw));
+
+    const uint64_t fold = 0x2020202020202020ull;
+    if ((in[0] | (kw[0] & fold)) != kw[0] || (in[1] | (kw[1] & fold)) != kw[1])
+        return false;
+
+    *type = slot->type;
+    return true;
+}
+
+/*
+ * Character classes for the tokenizer. A byte can belong to several classes;
+ * CC_BREAK marks the bytes that end an identifier or number run.
+ */
+enum
+{
+    CC_SPACE  = 1 << 0, // skipped between tokens
+    CC_SINGLE = 1 << 1, // one-byte token, see single_token_type[]
+    CC_IDENT  = 1 << 2, // starts an identifier
+    CC_DIGIT  = 1 << 3, // starts a number
+    CC_QUOTE  = 1 << 4, // starts a quoted value
+    CC_BREAK  = 1 << 5, // ends an identifier or number
+};
+
+/*
+ * char_class - Class bits for every byte value. Bytes without a class are
+ * skipped between tokens and are part of an identifier or number run.
+ */
+static const unsigned char char_class[256] = {
+    ['\0'] = CC_BREAK,
+
+    ['\t'] = CC_SPACE | CC_BREAK,
+    ['\n'] = CC_SPACE | CC_BREAK,
+    ['\v'] = CC_SPACE | CC_BREAK,
+    ['\f'] = CC_SPACE | CC_BREAK,
+    ['\r'] = CC_SPACE | CC_BREAK,
+    [' ']  = CC_SPACE | CC_BREAK,
+
+    [','] = CC_SINGLE | CC_BREAK,
+    [';'] = CC_SINGLE | CC_BREAK,
+    ['='] = CC_SINGLE | CC_BREAK,
+    ['('] = CC_SINGLE | CC_BREAK,
+    [')'] = CC_SINGLE | CC_BREAK,
+    ['*'] = CC_SINGLE,
+
+    ['\''] = CC_QUOTE,
+    ['"']  = CC_QUOTE,
+
+    ['0'] = CC_DIGIT, ['1'] = CC_DIGIT, ['2'] = CC_DIGIT, ['3'] = CC_DIGIT,
+    ['4'] = CC_DIGIT, ['5'] = CC_DIGIT, ['6'] = CC_DIGIT, ['7'] = CC_DIGIT,
+    ['8'] = CC_DIGIT, ['9'] = CC_DIGIT,
+
+    ['A'] = CC_IDENT, ['B'] = CC_IDENT, ['C'] = CC_IDENT, ['D'] = CC_IDENT,
+    ['E'] = CC_IDENT, ['F'] = CC_IDENT, ['G'] = CC_IDENT, ['H'] = CC_IDENT,
+    ['I'] = CC_IDENT, ['J'] = CC_IDENT, ['K'] = CC_IDENT, ['L'] = CC_IDENT,
+    ['M'] = CC_IDENT,
+    ['N'] = CC_IDENT, ['O'] = CC_IDENT, ['P'] = CC_IDENT, ['Q'] = CC_IDENT,
+    ['R'] = CC_IDENT, ['S'] = CC_IDENT, ['T'] = CC_IDENT, ['U'] = CC_IDENT,
+    ['V'] = CC_IDENT, ['W'] = CC_IDENT, ['X'] = CC_IDENT, ['Y'] = CC_IDENT,
+    ['Z'] = CC_IDENT,
+    ['a'] = CC_IDENT, ['b'] = CC_IDENT, ['c'] = CC_IDENT, ['d'] = CC_IDENT,
+    ['e'] = CC_IDENT, ['f'] = CC_IDENT, ['g'] = CC_IDENT, ['h'] = CC_IDENT,
+    ['i'] = CC_IDENT, ['j'] = CC_IDENT, ['k'] = CC_IDENT, ['l'] = CC_IDENT,
+    ['m'] = CC_IDENT,
+    ['n'] = CC_IDENT, ['o'] = CC_IDENT, ['p'] = CC_IDENT, ['q'] = CC_IDENT,
+    ['r'] = CC_IDENT, ['s'] = CC_IDENT, ['t'] = CC_IDENT, ['u'] = CC_IDENT,
+    ['v'] = CC_IDENT, ['w'] = CC_IDENT, ['x'] = CC_IDENT, ['y'] = CC_IDENT,
+    ['z'] = CC_IDENT,
+    ['_'] = CC_IDENT,
+};
+
+/*
+ * single_token_type - Token type of each CC_SINGLE byte
+ */
+static const SqlSymbols single_token_type[256] = {
+    [','] = COMMA,
+    [';'] = SEMICOLON,
+    ['='] = EQUALS,
+    ['('] = ROUND_BRACKETS_OPEN,
+    [')'] = ROUND_BRACKETS_CLOSE,
+    ['*'] = STAR,
+};
+
+/*
+ * Scanning kernels
+ *
+ * The tokenizer spends most of its time finding the end of runs: whitespace
+ * between tokens, identifier/number bytes up to the next CC_BREAK and the
+ * bytes up to a closing quote. Each kernel returns the first index >= @i
+ * (and <= @len) whose byte ends the run. The scalar kernels define the
+ * semantics; the SSE2 and AVX2 kernels test 16/32 bytes per step and finish
+ * the tail with the scalar code.
+ */
+typedef struct
+{
+    const char* name;
+    size_t (*skip_space)(const unsigned char* s, size_t i, size_t len);
+    size_t (*skip_run)(const unsigned char* s, size_t i, size_t len);
+    size_t (*find_quote)(const unsigned char* s,
+                         size_t i,
+                         size_t len,
+                         unsigned char quote);
+} ScanKernels;
+
+static size_t scalar_skip_space(const unsigned char* s, size_t i, size_t len)
+{
+    while (i < len && (char_class[s[i]] & CC_SPACE))
+        i++;
+    return i;
+}
+
+static size_t scalar_skip_run(const unsigned char* s, size_t i, size_t len)
+{
+    while (i < len && !(char_class[s[i]] & CC_BREAK))
+        i++;
+    return i;
+}
+
+static size_t scalar_find_quote(const unsigned char* s,
+                                size_t i,
+                                size_t len,
+                                unsigned char quote)
+{
+    while (i < len && s[i] != quote)
+        i++;
+    return i;
+}
+
+static const ScanKernels scan_scalar = {
+    "scalar",
+    scalar_skip_space,
+    scalar_skip_run,
+    scalar_find_quote,
+};
+
+#ifdef SCANQL_X86_SIMD
+/*
+ * Whitespace is ' ' or the contiguous range '\t'..'\r'. The range test
+ * subtracts '\t' and keeps bytes that are <= 4 as unsigned values.
+ */
+static inline __m128i sse2_is_space(__m128i v)
+{
+    __m128i r = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i in_range =
+        _mm_cmpeq_epi8(_mm_min_epu8(r, _mm_set1_epi8(4)), r);
+    return _mm_or_si128(in_range, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+
+/* CC_BREAK bytes: whitespace, '\0' and , ; = ( ) */
+static inline __m128i sse2_is_break(__m128i v)
+{
+    __m128i m = sse2_is_space(v);
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(',')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(';')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('=')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('(')));
+    return _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(')')));
+}
+
+static size_t sse2_skip_space(const unsigned char* s, size_t i, size_t len)
+{
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v     = _mm_loadu_si128((const __m128i*)(s + i));
+        unsigned mask = ~(unsigned)_mm_movemask_epi8(sse2_is_space(v)) & 0xffff;
+        if (mask)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+    return scalar_skip_space(s, i, len);
+}
+
+static size_t sse2_skip_run(const unsigned char* s, size_t i, size_t len)
+{
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v     = _mm_loadu_si128((const __m128i*)(s + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(sse2_is_break(v));
+        if (mask)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+    return scalar_skip_run(s, i, len);
+}
+
+static size_t sse2_find_quote(const unsigned char* s,
+                              size_t i,
+                              size_t len,
+                              unsigned char quote)
+{
+    __m128i q = _mm_set1_epi8((char)quote);
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v     = _mm_loadu_si128((const __m128i*)(s + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, q));
+        if (mask)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+    return scalar_find_quote(s, i, len, quote);
+}
+
+static const ScanKernels scan_sse2 = {
+    "sse2",
+    sse2_skip_space,
+    sse2_skip_run,
+    sse2_find_quote,
+};
+
+__attribute__((target("avx2"))) static inline __m256i avx2_is_space(__m256i v)
+{
+    __m256i r = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    __m256i in_range =
+        _mm256_cmpeq_epi8(_mm256_min_epu8(r, _mm256_set1_epi8(4)), r);
+    return _mm256_or_si256(in_range,
+                           _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+}
+
+__attribute__((target("avx2"))) static inline __m256i avx2_is_break(__m256i v)
+{
+    __m256i m = avx2_is_space(v);
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(';')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('=')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('(')));
+    return _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(')')));
+}
+
+__attribute__((target("avx2"))) static size_t
+avx2_skip_space(const unsigned char* s, size_t i, size_t len)
+{
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v     = _mm256_loadu_si256((const __m256i*)(s + i));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(avx2_is_space(v));
+        if (mask)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+    return sse2_skip_space(s, i, len);
+}
+
+__attribute__((target("avx2"))) static size_t
+avx2_skip_run(const unsigned char* s, size_t i, size_t len)
+{
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v     = _mm256_loadu_si256((const __m256i*)(s + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(avx2_is_break(v));
+        if (mask)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+    return sse2_skip_run(s, i, len);
+}
+
+__attribute__((target("avx2"))) static size_t
+avx2_find_quote(const unsigned char* s,
+                size_t i,
+                size_t len,
+                unsigned char quote)
+{
+    __m256i q = _mm256_set1_epi8((char)quote);
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v     = _mm256_loadu_si256((const __m256i*)(s + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, q));
+        if (mask)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+    return sse2_find_quote(s, i, len, quote);
+}
+
+static const ScanKernels scan_avx2 = {
+    "avx2",
+    avx2_skip_space,
+    avx2_skip_run,
+    avx2_find_quote,
+};
+#endif
+
+/**
+ * available_scan_kernels - List the kernel sets this CPU can run
+ * @out: receives the kernel sets, narrowest first
+ *
+ * SSE2 is part of x86-64; AVX2 is detected at runtime.
+ *
+ * Return: number of entries written to @out (1 to 3).
+ */
+static int available_scan_kernels(const ScanKernels* out[3])
+{
+    int n    = 0;
+    out[n++] = &scan_scalar;
+#ifdef SCANQL_X86_SIMD
+    out[n++] = &scan_sse2;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        out[n++] = &scan_avx2;
+#endif
+    return n;
+}
+
+/*
+ * scan - Kernels used by get_tokens. The widest available set is selected
+ * once at startup; tests and benchmarks may point it at another set.
+ */
+static const ScanKernels* scan = &scan_scalar;
+
+__attribute__((constructor)) static void init_scan_kernels(void)
+{
+    const ScanKernels* sets[3];
+    scan = sets[available_scan_kernels(sets) - 1];
+}
+
+/**
+ * struct Lexer - Read cursor of the tokenizer over one SQL buffer
+ * @src: input bytes
+ * @index: offset of the next byte to read
+ * @len: number of bytes in @src
+ */
+typedef struct
+{
+    const unsigned char* src;
+    size_t index;
+    size_t len;
+} Lexer;
+
+/**
+ * lexer_init - Start lexing a SQL buffer
+ * @sql: input SQL text; must outlive the lexer and its tokens
+ * @len: bytes in @sql; no NUL terminator is needed
+ *
+ * Return: lexer positioned at the first byte.
+ */
+Lexer lexer_init(const char* sql, size_t len)
+{
+    Lexer lx = {
+        .src   = (const unsigned char*)sql,
+        .index = 0,
+        .len   = len,
+    };
+    return lx;
+}
+
+/**
+ * next_token - Produce the next token of the input
+ * @lx: lexer state, advanced past the returned token
+ * @token: receives the token
+ *
+ * Tokens only record the offset and length of their lexeme. Every byte is
+ * classified once through char_class[]; quoted values record the bytes
+ * between the quotes and may be empty.
+ *
+ * Return: true if a token was produced, false at the end of the input.
+ */
+static inline bool next_token(Lexer* lx, Token* token)
+{
+    const unsigned char* src = lx->src;
+    size_t index             = lx->index;
+    size_t last_index        = lx->len;
+
+    while (index < last_index)
+    {
+        unsigned char c   = src[index];
+        unsigned char cls = char_class[c];
+        Token t           = {.pos = index};
+
+        if (cls & CC_SPACE)
+        {
+            index++;
+            if (index < last_index && (char_class[src[index]] & CC_SPACE))
+                index = scan->skip_space(src, index, last_index);
+            continue;
+        }
+        else if (cls & CC_SINGLE)
+        {
+            t.type = single_token_type[c];
+            index++;
+        }
+        else if (cls & CC_QUOTE)
+        {
+            t.type = c == '"' ? DOUBLE_QUOTED_VALUE : SINGLE_QUOTED_VALUE;
+            t.pos  = ++index; // skip the opening quote
+            index  = scan->find_quote(src, index, last_index, c);
+        }
+        else if (cls & (CC_IDENT | CC_DIGIT))
+        {
+            t.type = (cls & CC_IDENT) ? SQL_IDENTIFIER : NUMBER;
+            index  = scan->skip_run(src, index + 1, last_index);
+        }
+        else
+        {
+            /* Unknown character: skip it and continue */
+            index++;
+            continue;
+        }
+
+        t.len = index - t.pos;
+
+        if (t.type == DOUBLE_QUOTED_VALUE || t.type == SINGLE_QUOTED_VALUE)
+        {
+            if (index < last_index) // consume the closing quote
+                index++;
+        }
+        else if (t.type == SQL_IDENTIFIER)
+        {
+            lookup_keyword((const char*)src + t.pos, t.len, &t.type);
+        }
+
+        lx->index = index;
+        *token    = t;
+        return true;
+    }
+
+    lx->index = index;
+    return false;
+}
+
+/**
+ * get_tokens - Tokenize a SQL buffer into a TokenStack
+ * @sql: input SQL text; must outlive the returned tokens
+ * @len: bytes in @sql
+ * @arena: arena the token arrays grow in
+ *
+ * Note: This is a very small tokenizer tailored to the validator. It is not a
+ * full SQL lexer. If the arena runs out of memory the stack comes back with
+ * &TokenStack.truncated set and must not be validated as the whole input.
+ */
+TokenStack get_tokens(const char* sql, size_t len, Arena* arena)
+{
+    assert(sql != NULL);
+    assert(arena != NULL);
+
+    Lexer lx             = lexer_init(sql, len);
+    TokenStack tokenList = token_stack_init(arena);
+
+    Token token;
+    while (next_token(&lx, &token))
+    {
+        append(&tokenList, token);
+    }
+    return tokenList;
+}
+
+/**
+ * struct Valid_Symbols - Represents a set of valid expected symbols
+ * @mask: bit SYM(s) is set for every expected SqlSymbols value s
+ */
+typedef struct
+{
+    uint64_t mask;
+} Valid_Symbols;
+
+/* SYM - Bit of a symbol inside Valid_Symbols.mask */
+#define SYM(s) ((uint64_t)1 << (s))
+
+static_assert(END < 64, "SqlSymbols must fit into the Valid_Symbols mask");
+
+/*
+ * Keyword suggestions, only computed for a failed statement. A name that
+ * stands where keywords were expected is compared with each of them by
+ * restricted Damerau-Levenshtein distance, so "SELEC" and "FORM" are one
+ * edit away from SELECT and FROM.
+ */
+static_assert(KEYWORD_MAX_LEN + 2 <= 64,
+              "suggestion patterns must fit into one word");
+
+/**
+ * struct EditPattern - Match masks of a string of up to 64 bytes
+ * @peq: bit i of @peq[c] is set where byte i of the pattern is c,
+ *       case-folded
+ * @len: pattern length
+ */
+typedef struct
+{
+    uint64_t peq[256];
+    size_t len;
+} EditPattern;
+
+static void edit_pattern_init(EditPattern* p, const char* s, size_t len)
+{
+    assert(len <= 64);
+    memset(p->peq, 0, sizeof(p->peq));
+    for (size_t i = 0; i < len; i++)
+        p->peq[tolower((unsigned char)s[i])] |= (uint64_t)1 << i;
+    p->len = len;
+}
+
+/**
+ * edit_distance - Restricted Damerau-Levenshtein distance to a pattern
+ * @p: pattern
+ * @text: string to compare with, case-insensitive
+ * @len: bytes in @text
+ *
+ * Hyyrö's bit-parallel algorithm: a column of the edit distance matrix is
+ * kept as vertical +1/-1 deltas in two words, and each byte of @text
+ * advances it in a fixed number of word operations. The transposition term
+ * lets swapped neighbours count as one edit.
+ *
+ * Return: minimum number of insertions, deletions, substitutions and
+ * adjacent transpositions between the pattern and @text.
+ */
+static size_t edit_distance(const EditPattern* p, const char* text, size_t len)
+{
+    if (p->len == 0)
+        return len;
+
+    uint64_t last    = (uint64_t)1 << (p->len - 1);
+    uint64_t vp      = ~(uint64_t)0;
+    uint64_t vn      = 0;
+    uint64_t d0      = 0;
+    uint64_t pm_prev = 0;
+    size_t score     = p->len;
+
+    for (size_t j = 0; j < len; j++)
+    {
+        uint64_t pm = p->peq[tolower((unsigned char)text[j])];
+        uint64_t tr = ((~d0 & pm) << 1) & pm_prev;
+        d0          = (((pm & vp) + vp) ^ vp) | pm | vn | tr;
+
+        uint64_t hp = vn | ~(d0 | vp);
+        uint64_t hn = vp & d0;
+        if (hp & last)
+            score++;
+        else if (hn & last)
+            score--;
+
+        hp      = (hp << 1) | 1;
+        vp      = (hn << 1) | ~(d0 | hp);
+        vn      = hp & d0;
+        pm_prev = pm;
+    }
+    return score;
+}
+
+/**
+ * suggest_keyword - Closest expected keyword to a misspelled name
+ * @s: the name
+ * @len: bytes in @s
+ * @expected: token types accepted in its place
+ *
+ * Names of five bytes and more may be two edits away, of three and four
+ * bytes one edit; shorter names are never taken for keywords. Ties go to
+ * the keyword listed first in keywords.txt.
+ *
+ * Return: the keyword's token type, or END if none is close enough.
+ */
+static SqlSymbols suggest_keyword(const char* s, size_t len, uint64_t expected)
+{
+    size_t limit = len >= 5 ? 2 : len >= 3 ? 1 : 0;
+    if (limit == 0 || len > KEYWORD_MAX_LEN + limit)
+        return END;
+
+    EditPattern p;
+    edit_pattern_init(&p, s, len);
+
+    SqlSymbols best = END;
+    size_t best_d   = limit + 1;
+    for (int i = 0; i < keyword_count; i++)
+    {
+        if (!(expected & SYM(keywords[i].type)))
+            continue;
+
+        /* The length difference alone is a lower bound */
+        size_t n = strlen(keywords[i].value);
+        if ((n > len ? n - len : len - n) >= best_d)
+            continue;
+
+        size_t d = edit_distance(&p, keywords[i].value, n);
+        if (d < best_d)
+        {
+            best   = keywords[i].type;
+            best_d = d;
+        }
+    }
+    return best;
+}
+
+/**
+ * struct ValidationError - A single validation error detail
+ * @token: offending token; type END when the error relates to EOF
+ * @position: index in the token stream (0-based)
+ * @expected: tokens that were expected at this position
+ * @message: human-readable diagnostic message
+ */
+typedef struct
+{
+    Token token;
+    size_t position;
+    Valid_Symbols expected;
+    const char* message;
+} ValidationError;
+
+/**
+ * struct ValidationResult - Aggregated validation outcome
+ * @ok: true when no errors were found
+ * @error_count: total number of errors detected (may exceed capacity)
+ * @error_capacity: capacity of the caller-provided @errors buffer
+ * @errors: pointer to caller-provided buffer to store up to @error_capacity
+ * errors
+ * @sql: original SQL text, used for context printing (may be NULL)
+ * @sql_len: bytes in @sql
+ * @error_limit: stop validating once this many errors were found; 0 means
+ * no limit, 1 returns at the first error
+ */
+typedef struct
+{
+    bool ok;
+    size_t error_count;
+    size_t error_capacity;
+    ValidationError* errors;
+    const char* sql;
+    size_t sql_len;
+    size_t error_limit;
+} ValidationResult;
+
+/**
+ * record_error - Append an error into the result buffer if space remains
+ * @r: validation result accumulator
+ * @tok: offending token (type END for EOF)
+ * @pos: token index
+ * @expected: expected parser state
+ * @msg: short diagnostic string (must outlive the result)
+ */
+static void record_error(ValidationResult* r,
+                         Token tok,
+                         size_t pos,
+                         Valid_Symbols expected,
+                         const char* msg)
+{
+    assert(r != NULL);
+    r->ok = false;
+    if (r->error_count < r->error_capacity)
+    {
+        ValidationError* e = &r->errors[r->error_count];
+        e->token           = tok;
+        e->position        = pos;
+        e->expected        = expected;
+        e->message         = msg;
+    }
+    r->error_count++;
+}
+
+/* True once @r holds as many errors as its limit allows. */
+static inline bool error_limit_reached(const ValidationResult* r)
+{
+    return r->error_limit != 0 && r->error_count >= r->error_limit;
+}
+
+/**
+ * validation_result_init - Prepare a result with its error buffer in an arena
+ * @arena: arena for the error buffer
+ * @error_limit: see ValidationResult.error_limit
+ * @max_tokens: upper bound of tokens to validate; sizes the buffer when
+ *              @error_limit is 0
+ *
+ * At most one error is recorded per token plus one for the end of input, so
+ * the buffer never needs more than @max_tokens + 1 entries.
+ *
+ * Return: result ready for validation; without buffer if the arena is out
+ * of memory (errors are then only counted).
+ */
+ValidationResult validation_result_init(Arena* arena,
+                                        size_t error_limit,
+                                        size_t max_tokens)
+{
+    size_t room = max_tokens + 1;
+    if (error_limit != 0 && error_limit < room)
+        room = error_limit;
+
+    ValidationResult r = {
+        .ok          = true,
+        .errors      = arena_alloc(arena, room * sizeof(ValidationError)),
+        .error_limit = error_limit,
+    };
+    r.error_capacity = r.errors ? room : 0;
+    return r;
+}
+
+/*
+ * TOKEN_CLASS_COUNT - Width of a grammar_next[] row. Rows are padded to 32
+ * token classes so that two rows share a cache line.
+ */
+#define TOKEN_CLASS_COUNT 32
+
+static_assert(END < TOKEN_CLASS_COUNT, "SqlSymbols must fit a grammar row");
+
+/*
+ * grammar.h is generated from grammar.txt by scripts/gen-grammar.py. It
+ * defines the GrammarState enum, GRAMMAR_START and the dense transition
+ * table grammar_next[state][token]; a cell holding STATE_ERROR rejects the
+ * token. END is the column used for the end of the input.
+ */
+#include "grammar.h"
+
+/**
+ * state_expected - Tokens a grammar state accepts, read from its table row
+ * @state: grammar state
+ *
+ * Only used to describe errors, so the row is scanned instead of keeping a
+ * second table in sync.
+ *
+ * Return: set of accepted tokens.
+ */
+Valid_Symbols state_expected(GrammarState state)
+{
+    Valid_Symbols expected = {0};
+    for (int tok = 0; tok <= END; tok++)
+    {
+        if (grammar_next[state][tok] != STATE_ERROR)
+            expected.mask |= SYM(tok);
+    }
+    return expected;
+}
+
+/**
+ * resync_state - Panic-mode recovery: where parsing resumes at a token
+ * @type: token after an error
+ *
+ * After an error the parser skips tokens up to the next synchronizing one:
+ * a ';' ends the broken statement, and a keyword that starts a statement
+ * restarts the grammar from its start state. The rejected token itself may
+ * be that token. Everything in between would only repeat the same error,
+ * so a broken statement costs one error instead of one per token.
+ *
+ * Return: the state to continue in, or STATE_ERROR to keep skipping.
+ */
+static inline GrammarState resync_state(SqlSymbols type)
+{
+    if (type == SEMICOLON)
+        return STATE_SEMICOLON;
+    return grammar_next[GRAMMAR_START][type];
+}
+
+/**
+ * validate_query_with_errors - Validate and collect all errors
+ * @tokens: token stack to validate
+ * @result: output accumulator (caller provides storage)
+ *
+ * Each token costs one grammar_next[] load. After a rejected token the
+ * parser recovers at the next synchronizing token, see resync_state(); the
+ * tokens skipped until then, the end of the input included, report no
+ * errors of their own.
+ *
+ * Returns: true if no errors, false otherwise. Continues after mismatches
+ * until @result->error_limit errors were found.
+ */
+bool validate_query_with_errors(const TokenStack* tokens,
+                                ValidationResult* result)
+{
+    assert(tokens != NULL);
+    assert(result != NULL);
+
+    result->ok          = true;
+    result->error_count = 0;
+
+    if (tokens->len == 0)
+    {
+        return true;
+    }
+
+    GrammarState state = GRAMMAR_START;
+    bool panic         = false;
+
+    for (size_t i = 0; i <= tokens->len; i++)
+    {
+        bool is_eof       = (i == tokens->len);
+        SqlSymbols t_type = is_eof ? END : (SqlSymbols)tokens->types[i];
+
+        GrammarState next =
+            panic ? resync_state(t_type) : grammar_next[state][t_type];
+        if (next == STATE_ERROR && !panic)
+        {
+            Token t = is_eof ? (Token){.type = END} : token_at(tokens, i);
+            record_error(
+                result, t, i, state_expected(state), "unexpected token");
+            if (error_limit_reached(result))
+                break;
+            next = resync_state(t_type);
+        }
+        panic = next == STATE_ERROR;
+        if (!panic)
+            state = next;
+    }
+
+    return result->ok;
+}
+
+/**
+ * check_query - Lex and validate in a single pass, without a token array
+ * @sql: SQL text
+ * @len: bytes in @sql
+ *
+ * Every token goes straight from next_token() into the grammar table, so the
+ * check needs no arena and constant memory, and it stops at the first error.
+ * It accepts exactly what get_tokens() + validate_query_with_errors() accept;
+ * run those to get diagnostics for a failing statement.
+ *
+ * Return: true if the query is valid, false otherwise.
+ */
+bool check_query(const char* sql, size_t len)
+{
+    assert(sql != NULL);
+
+    Lexer lx           = lexer_init(sql, len);
+    GrammarState state = GRAMMAR_START;
+    bool empty         = true;
+
+    Token t;
+    while (next_token(&lx, &t))
+    {
+        state = grammar_next[state][t.type];
+        if (state == STATE_ERROR)
+            return false;
+        empty = false;
+    }
+
+    return empty || grammar_next[state][END] != STATE_ERROR;
+}
+
+/**
+ * validate_query - Convenience wrapper that only reports success/failure
+ * @tokens: token stack to validate
+ *
+ * Returns: true if query is valid, false otherwise.
+ */
+bool validate_query(const TokenStack* tokens)
+{
+    if (!tokens)
+        return false;
+
+    ValidationError first;
+    ValidationResult res = {
+        .ok             = true,
+        .error_count    = 0,
+        .error_capacity = 1,
+        .errors         = &first,
+        .error_limit    = 1,
+    };
+
+    return validate_query_with_errors(tokens, &res);
+}
+
+/**
+ * check_query_with_errors - Lex and validate in one pass, recording errors
+ * @sql: SQL text
+ * @len: bytes in @sql
+ * @result: output accumulator (caller provides storage)
+ *
+ * Finds the same errors as get_tokens() + validate_query_with_errors(), with
+ * the same recovery, but without a token array. With an error limit the
+ * input is only read up to the last recorded error, so rejecting a
+ * statement costs time proportional to where it goes wrong.
+ *
+ * Return: true if no errors, false otherwise.
+ */
+bool check_query_with_errors(const char* sql,
+                             size_t len,
+                             ValidationResult* result)
+{
+    assert(sql != NULL);
+    assert(result != NULL);
+
+    result->ok          = true;
+    result->error_count = 0;
+
+    Lexer lx           = lexer_init(sql, len);
+    GrammarState state = GRAMMAR_START;
+    bool panic         = false;
+
+    Token t;
+    for (size_t i = 0;; i++)
+    {
+        bool is_eof = !next_token(&lx, &t);
+        if (is_eof)
+        {
+            if (i == 0)
+                break; // empty input
+            t = (Token){.type = END};
+        }
+
+        GrammarState next =
+            panic ? resync_state(t.type) : grammar_next[state][t.type];
+        if (next == STATE_ERROR && !panic)
+        {
+            record_error(
+                result, t, i, state_expected(state), "unexpected token");
+            if (error_limit_reached(result))
+                break;
+            next = resync_state(t.type);
+        }
+        panic = next == STATE_ERROR;
+        if (!panic)
+            state = next;
+
+        if (is_eof)
+            break;
+    }
+
+    return result->ok;
+}
+
+/**
+ * struct StreamResult - Verdict for one statement of a validation stream
+ * @index: 1-based statement number within the stream
+ * @start: stream offset of the statement's first token
+ * @end: stream offset just past the statement (after its ';')
+ * @ok: true if the statement is valid
+ * @error_offset: stream offset of the offending token, or @end if the
+ *                statement ended too early
+ * @error_type: type of the offending token, END for an unexpected end
+ * @error_index: index of the offending token within the statement
+ * @expected: token types the grammar would have accepted instead
+ */
+typedef struct
+{
+    size_t index;
+    size_t start;
+    size_t end;
+    bool ok;
+    size_t error_offset;
+    SqlSymbols error_type;
+    size_t error_index;
+    Valid_Symbols expected;
+} StreamResult;
+
+typedef void (*StreamCallback)(const StreamResult* result, void* user);
+
+/* What the stream lexer was in the middle of when a chunk ran out. */
+typedef enum : unsigned char
+{
+    STREAM_LEX_NONE,    // between tokens
+    STREAM_LEX_RUN,     // identifier or number
+    STREAM_LEX_QUOTE,   // quoted value, closing quote not seen yet
+    STREAM_LEX_DASH,    // one '-' before the first token of a statement
+    STREAM_LEX_COMMENT, // "--" comment before the first token of a statement
+} StreamLexState;
+
+/**
+ * struct StreamValidator - Push-style validator over chunked input
+ * @lex: token the previous chunk ended inside of
+ * @quote: closing quote byte of an open quoted value
+ * @pending_type: type of the unfinished token
+ * @pending_pos: stream offset of the unfinished token's lexeme
+ * @pending_len: lexeme bytes of the unfinished token seen so far
+ * @prefix: leading bytes of an unfinished identifier, for keyword lookup
+ * @offset: stream offset of the first byte of the current chunk
+ * @state: grammar state of the current statement
+ * @failed: the current statement already has an error
+ * @tokens: tokens seen in the current statement
+ * @current: verdict being built for the current statement
+ * @on_result: called once per completed statement
+ * @user: passed through to @on_result
+ *
+ * Only the bytes needed to resume are kept between chunks: the lexer
+ * position inside a token and at most KEYWORD_MAX_LEN bytes of an
+ * identifier. Statements end at a ';' outside quotes, like next_statement().
+ */
+typedef struct
+{
+    StreamLexState lex;
+    unsigned char quote;
+    SqlSymbols pending_type;
+    size_t pending_pos;
+    size_t pending_len;
+    char prefix[KEYWORD_MAX_LEN];
+    size_t offset;
+    GrammarState state;
+    bool failed;
+    size_t tokens;
+    StreamResult current;
+    StreamCallback on_result;
+    void* user;
+} StreamValidator;
+
+/**
+ * stream_init - Prepare a stream validator
+ * @sv: validator to initialise
+ * @on_result: called with the verdict of every completed statement
+ * @user: opaque pointer passed to @on_result
+ */
+void stream_init(StreamValidator* sv, StreamCallback on_result, void* user)
+{
+    assert(sv != NULL);
+    assert(on_result != NULL);
+
+    memset(sv, 0, sizeof(*sv));
+    sv->lex       = STREAM_LEX_NONE;
+    sv->state     = GRAMMAR_START;
+    sv->on_result = on_result;
+    sv->user      = user;
+}
+
+static void stream_fail(StreamValidator* sv, size_t offset, SqlSymbols type)
+{
+    sv->failed               = true;
+    sv->current.ok           = false;
+    sv->current.error_offset = offset;
+    sv->current.error_type   = type;
+    sv->current.error_index  = type == END ? sv->tokens : sv->tokens - 1;
+    sv->current.expected     = state_expected(sv->state);
+}
+
+/* Close the current statement at stream offset @end and report it. */
+static void stream_end_statement(StreamValidator* sv, size_t end)
+{
+    if (!sv->failed && grammar_next[sv->state][END] == STATE_ERROR)
+        stream_fail(sv, end, END);
+
+    sv->current.end = end;
+    sv->on_result(&sv->current, sv->user);
+
+    size_t index = sv->current.index;
+    sv->state    = GRAMMAR_START;
+    sv->failed   = false;
+    sv->tokens   = 0;
+    memset(&sv->current, 0, sizeof(sv->current));
+    sv->current.index = index;
+}
+
+/* Feed one finished token into the grammar of the current statement. */
+static void stream_token(StreamValidator* sv, SqlSymbols type, size_t pos)
+{
+    if (sv->tokens++ == 0)
+    {
+        sv->current.index++;
+        sv->current.start = pos;
+        sv->current.ok    = true;
+    }
+
+    if (!sv->failed)
+    {
+        GrammarState next = grammar_next[sv->state][type];
+        if (next == STATE_ERROR)
+            stream_fail(sv, pos, type);
+        else
+            sv->state = next;
+    }
+
+    if (type == SEMICOLON)
+        stream_end_statement(sv, pos + 1);
+}
+
+/*
+ * Finish the pending identifier or number. @chunk is the current chunk; a
+ * lexeme that started in it is looked up in place, one that started in an
+ * earlier chunk through the saved prefix.
+ */
+static void stream_finish_run(StreamValidator* sv, const unsigned char* chunk)
+{
+    SqlSymbols type = sv->pending_type;
+
+    if (type == SQL_IDENTIFIER && sv->pending_len <= KEYWORD_MAX_LEN)
+    {
+        const char* lexeme = sv->pending_pos >= sv->offset
+                                 ? (const char*)chunk +
+                                       (sv->pending_pos - sv->offset)
+                                 : sv->prefix;
+        lookup_keyword(lexeme, sv->pending_len, &type);
+    }
+
+    sv->lex = STREAM_LEX_NONE;
+    stream_token(sv, type, sv->pending_pos);
+}
+
+/**
+ * stream_feed - Lex and validate the next chunk of a stream
+ * @sv: stream validator
+ * @data: chunk bytes; not retained after the call
+ * @len: number of bytes in @data, may be 0
+ *
+ * Chunks may split the input anywhere, including inside identifiers and
+ * quoted values. @sv->on_result runs for every statement whose ';' is in
+ * this chunk.
+ */
+void stream_feed(StreamValidator* sv, const char* data, size_t len)
+{
+    assert(sv != NULL);
+    assert(data != NULL || len == 0);
+
+    const unsigned char* s = (const unsigned char*)data;
+    size_t base            = sv->offset;
+    size_t i               = 0;
+
+    while (i < len)
+    {
+        switch (sv->lex)
+        {
+        case STREAM_LEX_RUN:
+        {
+            size_t end = scan->skip_run(s, i, len);
+            bool split = end == len || sv->pending_pos < base;
+
+            /* Keep what keyword lookup needs once this chunk is gone. */
+            if (split && sv->pending_type == SQL_IDENTIFIER &&
+                sv->pending_len < KEYWORD_MAX_LEN)
+            {
+                size_t room = KEYWORD_MAX_LEN - sv->pending_len;
+                size_t n    = end - i < room ? end - i : room;
+                memcpy(sv->prefix + sv->pending_len, s + i, n);
+            }
+            sv->pending_len += end - i;
+            i = end;
+            if (i < len)
+                stream_finish_run(sv, s);
+            break;
+        }
+        case STREAM_LEX_QUOTE:
+        {
+            size_t end = scan->find_quote(s, i, len, sv->quote);
+            sv->pending_len += end - i;
+            i = end;
+            if (i < len)
+            {
+                i++; // consume the closing quote
+                sv->lex = STREAM_LEX_NONE;
+                stream_token(sv, sv->pending_type, sv->pending_pos);
+            }
+            break;
+        }
+        case STREAM_LEX_DASH:
+            sv->lex = STREAM_LEX_NONE;
+            if (s[i] == '-')
+            {
+                sv->lex = STREAM_LEX_COMMENT;
+                i++;
+            }
+            break;
+        case STREAM_LEX_COMMENT:
+        {
+            const unsigned char* nl = memchr(s + i, '\n', len - i);
+            if (nl)
+            {
+                sv->lex = STREAM_LEX_NONE;
+                i       = (size_t)(nl - s) + 1;
+            }
+            else
+            {
+                i = len;
+            }
+            break;
+        }
+        case STREAM_LEX_NONE:
+        {
+            unsigned char c   = s[i];
+            unsigned char cls = char_class[c];
+
+            if (cls & CC_SPACE)
+            {
+                i = scan->skip_space(s, i + 1, len);
+            }
+            else if (cls & CC_SINGLE)
+            {
+                stream_token(sv, single_token_type[c], base + i);
+                i++;
+            }
+            else if (cls & CC_QUOTE)
+            {
+                sv->lex          = STREAM_LEX_QUOTE;
+                sv->quote        = c;
+                sv->pending_type = c == '"' ? DOUBLE_QUOTED_VALUE
+                                            : SINGLE_QUOTED_VALUE;
+                sv->pending_pos  = base + i + 1;
+                sv->pending_len  = 0;
+                i++;
+            }
+            else if (cls & (CC_IDENT | CC_DIGIT))
+            {
+                sv->lex          = STREAM_LEX_RUN;
+                sv->pending_type = (cls & CC_IDENT) ? SQL_IDENTIFIER : NUMBER;
+                sv->pending_pos  = base + i;
+                sv->pending_len  = 0;
+            }
+            else
+            {
+                /* Leading "--" comments are skipped like next_statement() */
+                if (c == '-' && sv->tokens == 0)
+                    sv->lex = STREAM_LEX_DASH;
+                i++;
+            }
+            break;
+        }
+        }
+    }
+
+    sv->offset = base + len;
+}
+
+/**
+ * stream_finish - Flush the end of the stream
+ * @sv: stream validator
+ *
+ * Closes a pending token and reports a trailing statement without ';'.
+ * The validator can be reused for a new stream after stream_init().
+ */
+void stream_finish(StreamValidator* sv)
+{
+    assert(sv != NULL);
+
+    if (sv->lex == STREAM_LEX_RUN)
+        stream_finish_run(sv, NULL);
+    else if (sv->lex == STREAM_LEX_QUOTE) // unterminated quote
+        stream_token(sv, sv->pending_type, sv->pending_pos);
+    sv->lex = STREAM_LEX_NONE;
+
+    if (sv->tokens > 0)
+        stream_end_statement(sv, sv->offset);
+}
+
+#define CLR_RED "\033[31m"
+#define CLR_YEL "\033[33m"
+#define CLR_GRN "\033[32m"
+#define CLR_DIM "\033[90m"
+#define CLR_RESET "\033[0m"
+
+/**
+ * struct TextBuf - Bounded output buffer that keeps counting past its end
+ * @out: output buffer (may be NULL if @cap is 0)
+ * @cap: size of @out
+ * @len: bytes written so far, including those that did not fit
+ *
+ * Reports are rendered into a TextBuf and written out in one piece, so the
+ * caller can size a buffer from @len and render again if it was too short.
+ * Bytes are only stored while one byte is left for the terminating NUL.
+ */
+typedef struct
+{
+    char* out;
+    size_t cap;
+    size_t len;
+} TextBuf;
+
+static void text_put(TextBuf* tb, const char* s, size_t n)
+{
+    if (tb->len + 1 < tb->cap)
+    {
+        size_t room = tb->cap - 1 - tb->len;
+        memcpy(tb->out + tb->len, s, n < room ? n : room);
+    }
+    tb->len += n;
+}
+
+static void text_puts(TextBuf* tb, const char* s)
+{
+    text_put(tb, s, strlen(s));
+}
+
+/* Append @n copies of @c */
+static void text_fill(TextBuf* tb, char c, size_t n)
+{
+    if (tb->len + 1 < tb->cap)
+    {
+        size_t room = tb->cap - 1 - tb->len;
+        memset(tb->out + tb->len, c, n < room ? n : room);
+    }
+    tb->len += n;
+}
+
+static void text_printf(TextBuf* tb, const char* fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void text_printf(TextBuf* tb, const char* fmt, ...)
+{
+    bool fits  = tb->len < tb->cap;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(fits ? tb->out + tb->len : NULL,
+                      fits ? tb->cap - tb->len : 0,
+                      fmt,
+                      ap);
+    va_end(ap);
+    if (n > 0)
+        tb->len += (size_t)n;
+}
+
+/* NUL-terminate @tb, truncating if needed */
+static void text_finish(TextBuf* tb)
+{
+    if (tb->cap > 0)
+        tb->out[tb->len < tb->cap ? tb->len : tb->cap - 1] = '\0';
+}
+
+/**
+ * describe_token - Render a token into a small textual description
+ * @e: validation error holding the token
+ * @sql: SQL source the token points into (may be NULL)
+ * @buf: output buffer
+ * @n: buffer size
+ */
+static void describe_token(const ValidationError* e,
+                           const char* sql,
+                           char* buf,
+                           size_t n)
+{
+    if (!e || !buf || n == 0)
+        return;
+
+    const Token* t = &e->token;
+    if (t->type == END)
+    {
+        snprintf(buf, n, "<EOF>");
+        return;
+    }
+
+    const char* kind = symbol_to_str[t->type];
+
+    /* Only what fits is read, however long the lexeme */
+    if (sql && t->len > 0)
+        snprintf(buf,
+                 n,
+                 "%s \"%.*s\"",
+                 kind,
+                 (int)(t->len < n ? t->len : n),
+                 sql + t->pos);
+    else
+        snprintf(buf, n, "%s", kind);
+}
+
+/**
+ * token_name - Write only the type name of a token's offending error into buf
+ * @e: validation error holding the token (may be NULL)
+ * @buf: output buffer
+ * @n: buffer size
+ */
+static void token_name(const ValidationError* e, char* buf, size_t n)
+{
+    if (!buf || n == 0)
+        return;
+
+    const Token* t = e ? &e->token : NULL;
+    if (!t || t->type == END)
+    {
+        snprintf(buf, n, "<EOF>");
+        return;
+    }
+
+    snprintf(buf, n, "%s", symbol_to_str[t->type]);
+}
+
+/**
+ * expected_to_str - Convert expected state to string label
+ */
+static void expected_to_str(Valid_Symbols e, char* buf, size_t n)
+{
+    if (!buf || n == 0)
+        return;
+
+    buf[0] = '\0';
+    for (uint64_t rest = e.mask; rest; rest &= rest - 1)
+    {
+        const char* name = symbol_to_str[__builtin_ctzll(rest)];
+
+        strncat(buf, name, n - strlen(buf) - 1);
+        if (rest & (rest - 1))
+        {
+            strncat(buf, " | ", n - strlen(buf) - 1);
+        }
+    }
+}
+
+/**
+ * struct LineIndex - Offsets of the line starts of a buffer, built lazily
+ * @buf: indexed text
+ * @len: bytes in @buf
+ * @lock: serializes the build
+ * @built: @starts and @count are final; set with release ordering
+ * @starts: offset of the first byte of every line, ascending
+ * @count: entries in @starts; 0 if the build ran out of memory
+ *
+ * Nothing is scanned until the first lookup, so inputs without errors never
+ * pay for the index. The build is one memchr() pass over @buf; every lookup
+ * after it is a binary search. Lookups may come from any number of threads.
+ */
+typedef struct
+{
+    const char* buf;
+    size_t len;
+    pthread_mutex_t lock;
+    atomic_bool built;
+    size_t* starts;
+    size_t count;
+} LineIndex;
+
+static void line_index_init(LineIndex* idx, const char* buf, size_t len)
+{
+    *idx = (LineIndex){.buf = buf, .len = len};
+    pthread_mutex_init(&idx->lock, NULL);
+    atomic_init(&idx->built, false);
+}
+
+static void line_index_free(LineIndex* idx)
+{
+    pthread_mutex_destroy(&idx->lock);
+    free(idx->starts);
+}
+
+static void line_index_build(LineIndex* idx)
+{
+    size_t cap     = 1024;
+    size_t* starts = malloc(cap * sizeof(*starts));
+    size_t count   = 0;
+    if (!starts)
+        return;
+
+    starts[count++] = 0;
+    const char* p   = idx->buf;
+    const char* end = idx->buf + idx->len;
+    while (p < end && (p = memchr(p, '\n', (size_t)(end - p))) != NULL)
+    {
+        if (count == cap)
+        {
+            size_t* grown = realloc(starts, 2 * cap * sizeof(*starts));
+            if (!grown)
+            {
+                free(starts);
+                return;
+            }
+            starts = grown;
+            cap *= 2;
+        }
+        starts[count++] = (size_t)(++p - idx->buf);
+    }
+
+    idx->starts = starts;
+    idx->count  = count;
+}
+
+/**
+ * line_index_locate - Line and column of a byte offset
+ * @idx: line index
+ * @offset: byte offset, at most @idx->len
+ * @line: receives the 1-based line number
+ * @line_start: receives the offset of the first byte of that line
+ *
+ * Return: false if the index could not be built.
+ */
+static bool line_index_locate(LineIndex* idx,
+                              size_t offset,
+                              size_t* line,
+                              size_t* line_start)
+{
+    if (!atomic_load_explicit(&idx->built, memory_order_acquire))
+    {
+        pthread_mutex_lock(&idx->lock);
+        if (!atomic_load_explicit(&idx->built, memory_order_relaxed))
+        {
+            line_index_build(idx);
+            atomic_store_explicit(&idx->built, true, memory_order_release);
+        }
+        pthread_mutex_unlock(&idx->lock);
+    }
+    if (idx->count == 0)
+        return false;
+
+    /* Last line start at or before @offset; starts[0] is 0 */
+    size_t lo = 0;
+    size_t hi = idx->count;
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idx->starts[mid] <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    *line       = lo + 1;
+    *line_start = idx->starts[lo];
+    return true;
+}
+
+/*
+ * Bytes of the offending line shown before the error and after the offending
+ * token; longer lines are cut, so a report costs the same on any input.
+ */
+#define CONTEXT_BEFORE 40
+#define CONTEXT_AFTER 40
+
+/**
+ * format_source_line - Render the line of an error with a caret under it
+ * @tb: buffer to render into
+ * @text: text the error is in
+ * @len: bytes in @text
+ * @pos: offset of the error in @text; @len for the end of the input
+ * @width: bytes to underline, 0 at the end of the input
+ * @line: 1-based line number of @pos
+ * @line_start: offset of the first byte of that line
+ * @color: highlight with ANSI colors
+ */
+static void format_source_line(TextBuf* tb,
+                               const char* text,
+                               size_t len,
+                               size_t pos,
+                               size_t width,
+                               size_t line,
+                               size_t line_start,
+                               bool color)
+{
+    const char* red   = color ? CLR_RED : "";
+    const char* reset = color ? CLR_RESET : "";
+
+    size_t after = width + CONTEXT_AFTER;
+    size_t from  = pos - line_start > CONTEXT_BEFORE ? pos - CONTEXT_BEFORE
+                                                     : line_start;
+    size_t to    = len - pos > after ? pos + after : len;
+
+    const char* nl = memchr(text + pos, '\n', to - pos);
+    if (nl)
+        to = (size_t)(nl - text);
+    bool cut_before = from > line_start;
+    bool cut_after  = !nl && to < len && text[to] != '\n';
+
+    text_printf(
+        tb, "  --> line %zu, column %zu\n  ", line, pos - line_start + 1);
+    if (cut_before)
+        text_puts(tb, "...");
+    text_put(tb, text + from, to - from);
+    if (cut_after)
+        text_puts(tb, "...");
+    text_puts(tb, "\n  ");
+
+    text_fill(tb, ' ', pos - from + (cut_before ? 3 : 0));
+    text_puts(tb, red);
+    if (width == 0)
+    {
+        text_printf(tb, "^%s (unerwartetes Ende)\n", reset);
+        return;
+    }
+    /* A token may run past the end of the line */
+    text_fill(tb, '^', width < to - pos ? width : to - pos);
+    text_printf(tb, "%s\n", reset);
+}
+
+/**
+ * format_validation_result - Render a validation outcome
+ * @tb: buffer to render into
+ * @result: validation result to render (must not be NULL)
+ * @color: highlight with ANSI colors
+ * @lines: index of the input result->sql is part of, or NULL
+ * @base: offset of result->sql in @lines->buf
+ *
+ * When result->sql is set and a bad token is found, the line of the offending
+ * token is shown with a caret (^) under it so the user can immediately see
+ * which part of the query is wrong. Line numbers count from the start of
+ * @lines->buf, or of result->sql without @lines.
+ */
+static void format_validation_result(TextBuf* tb,
+                                     const ValidationResult* result,
+                                     bool color,
+                                     LineIndex* lines,
+                                     size_t base)
+{
+    const char* red   = color ? CLR_RED : "";
+    const char* yel   = color ? CLR_YEL : "";
+    const char* grn   = color ? CLR_GRN : "";
+    const char* reset = color ? CLR_RESET : "";
+
+    if (result->ok)
+    {
+        text_printf(tb, "%svalidation: ok%s\n", grn, reset);
+        return;
+    }
+
+    if (result->error_capacity == 0)
+    {
+        text_printf(tb, "%svalidation failed%s\n", red, reset);
+        return;
+    }
+
+    const ValidationError* e0 = &result->errors[0];
+    char tokbuf[128];
+    char namebuf[64];
+    char expectedbuf[256];
+    describe_token(e0, result->sql, tokbuf, sizeof(tokbuf));
+    token_name(e0, namebuf, sizeof(namebuf));
+    expected_to_str(e0->expected, expectedbuf, sizeof(expectedbuf));
+
+    text_printf(tb,
+                "%svalidation failed%s at token %s: expected %s, got %s%s%s",
+                red,
+                reset,
+                namebuf,
+                expectedbuf,
+                yel,
+                tokbuf,
+                reset);
+    if (e0->message && e0->message[0])
+        text_printf(tb, " (%s)", e0->message);
+
+    if (e0->token.type == SQL_IDENTIFIER && result->sql)
+    {
+        SqlSymbols kw = suggest_keyword(result->sql + e0->token.pos,
+                                        e0->token.len,
+                                        e0->expected.mask);
+        if (kw != END)
+            text_printf(tb,
+                        ", did you mean %s%s%s?",
+                        grn,
+                        symbol_to_str[kw],
+                        reset);
+    }
+
+    if (result->error_count > 1)
+        text_printf(tb, " [and %zu more]", result->error_count - 1);
+
+    text_puts(tb, "\n");
+
+    if (!result->sql)
+        return;
+
+    /* Point past the end of the SQL for an EOF error */
+    bool eof     = e0->token.type == END;
+    size_t pos   = eof ? result->sql_len : e0->token.pos;
+    size_t width = eof ? 0 : e0->token.len;
+
+    size_t line;
+    size_t line_start;
+    if (lines && line_index_locate(lines, base + pos, &line, &line_start))
+    {
+        format_source_line(tb,
+                           lines->buf,
+                           lines->len,
+                           base + pos,
+                           width,
+                           line,
+                           line_start,
+                           color);
+        return;
+    }
+
+    /* Without an index, count the lines of the statement itself */
+    line       = 1;
+    line_start = 0;
+    for (const char* p = result->sql;
+         (p = memchr(p, '\n', (size_t)(result->sql + pos - p))) != NULL;
+         line++)
+        line_start = (size_t)(++p - result->sql);
+    format_source_line(
+        tb, result->sql, result->sql_len, pos, width, line, line_start, color);
+}
+
+/**
+ * fprint_validation_result - Pretty-print validation outcome
+ * @out: stream to print to
+ * @result: validation result to print (must not be NULL)
+ * @color: highlight with ANSI colors
+ *
+ * The report is rendered with format_validation_result() and written with a
+ * single fwrite(); only reports of long statements need a heap buffer.
+ */
+void fprint_validation_result(FILE* out,
+                              const ValidationResult* result,
+                              bool color)
+{
+    assert(out != NULL);
+    assert(result != NULL);
+
+    char stack[1024];
+    TextBuf tb = {.out = stack, .cap = sizeof(stack)};
+    format_validation_result(&tb, result, color, NULL, 0);
+    if (tb.len < tb.cap)
+    {
+        fwrite(stack, 1, tb.len, out);
+        return;
+    }
+
+    size_t len = tb.len;
+    tb         = (TextBuf){.out = malloc(len + 1), .cap = len + 1};
+    if (!tb.out)
+    {
+        fwrite(stack, 1, sizeof(stack) - 1, out); // truncated, but something
+        return;
+    }
+    format_validation_result(&tb, result, color, NULL, 0);
+    fwrite(tb.out, 1, len, out);
+    free(tb.out);
+}
+
+/**
+ * print_validation_result - fprint_validation_result() to stdout, in color
+ * @result: validation result to print (must not be NULL)
+ */
+void print_validation_result(const ValidationResult* result)
+{
+    fprint_validation_result(stdout, result, true);
+}
+
+/**
+ * struct StatementRange - One statement inside a batch input
+ * @start: byte offset of the first character of the statement
+ * @len: length in bytes, including the terminating semicolon (if any)
+ */
+typedef struct
+{
+    size_t start;
+    size_t len;
+} StatementRange;
+
+/**
+ * next_statement - Find the next statement in a multi-statement buffer
+ * @buf: input text
+ * @len: number of bytes in @buf
+ * @cursor: in/out read position, advanced past the returned statement
+ * @out: receives the statement range
+ *
+ * Leading whitespace, as classified by the lexer, and "--" line comments are
+ * skipped. A statement ends after the first semicolon outside of single or
+ * double quotes, or at the end of the input. Ranges that contain nothing but
+ * whitespace are skipped.
+ *
+ * Return: true if a statement was found, false when the input is exhausted.
+ */
+bool next_statement(const char* buf,
+                    size_t len,
+                    size_t* cursor,
+                    StatementRange* out)
+{
+    assert(buf != NULL);
+    assert(cursor != NULL);
+    assert(out != NULL);
+
+    size_t i = *cursor;
+    while (i < len)
+    {
+        char c = buf[i];
+        if (char_class[(unsigned char)c] & CC_SPACE)
+        {
+            i++;
+        }
+        else if (c == '-' && i + 1 < len && buf[i + 1] == '-')
+        {
+            while (i < len && buf[i] != '\n')
+                i++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (i >= len)
+    {
+        *cursor = len;
+        return false;
+    }
+
+    size_t start = i;
+    char quote   = '\0';
+    while (i < len)
+    {
+        char c = buf[i++];
+        if (quote)
+        {
+            if (c == quote)
+                quote = '\0';
+        }
+        else if (c == '\'' || c == '"')
+        {
+            quote = c;
+        }
+        else if (c == ';')
+        {
+            break;
+        }
+    }
+
+    out->start = start;
+    out->len   = i - start;
+    *cursor    = i;
+    return true;
+}
+
+/*
+ * Public API, see scanql.h. The wrappers translate between the internal
+ * types above and the stable ones of the header.
+ */
+static_assert((int)SCANQL_TOKEN_END == (int)END,
+              "scanql_token_type must mirror SqlSymbols");
+static_assert((int)SCANQL_TOKEN_IDENTIFIER == (int)SQL_IDENTIFIER,
+              "scanql_token_type must mirror SqlSymbols");
+
+static scanql_token public_token(Token t)
+{
+    scanql_token pt = {
+        .type   = (scanql_token_type)t.type,
+        .offset = t.pos,
+        .length = t.len,
+    };
+    return pt;
+}
+
+/* Fills @result for a failing statement of @len bytes from its first error */
+static void public_failure(scanql_result* result,
+                           const ValidationError* first,
+                           size_t error_count,
+                           size_t len)
+{
+    result->ok          = false;
+    result->error_count = error_count;
+    result->error_index = first->position;
+    result->expected    = first->expected.mask;
+    result->error       = public_token(first->token);
+    if (first->token.type == END)
+        result->error.offset = len;
+}
+
+const char* scanql_version(void)
+{
+    return SCANQL_VERSION;
+}
+
+const char* scanql_token_name(scanql_token_type type)
+{
+    if ((unsigned)type > END)
+        return "?";
+    return symbol_to_str[type];
+}
+
+bool scanql_check(const char* buf, size_t len)
+{
+    assert(buf != NULL || len == 0);
+    /* Empty input may be passed as (NULL, 0); the lexer wants a pointer */
+    if (!buf)
+        buf = "";
+    return check_query(buf, len);
+}
+
+bool scanql_validate(const char* buf, size_t len, scanql_result* result)
+{
+    assert(buf != NULL || len == 0);
+    if (!buf)
+        buf = "";
+    assert(result != NULL);
+
+    size_t limit = result->error_limit;
+    *result      = (scanql_result){.error_limit = limit, .ok = true};
+    if (check_query(buf, len))
+        return true;
+
+    ValidationError first;
+    ValidationResult res = {
+        .ok             = true,
+        .error_capacity = 1,
+        .errors         = &first,
+        .error_limit    = limit,
+    };
+    check_query_with_errors(buf, len, &res);
+    public_failure(result, &first, res.error_count, len);
+    return false;
+}
+
+scanql_token_type
+scanql_suggest(const char* buf, size_t len, const scanql_result* result)
+{
+    assert(result != NULL);
+    const scanql_token* t = &result->error;
+    if (!buf || result->ok || t->type != SCANQL_TOKEN_IDENTIFIER ||
+        t->offset > len || t->length > len - t->offset)
+        return SCANQL_TOKEN_END;
+
+    return (scanql_token_type)suggest_keyword(
+        buf + t->offset, t->length, result->expected);
+}
+
+size_t scanql_tokenize(const char* buf,
+                       size_t len,
+                       scanql_token* tokens,
+                       size_t capacity)
+{
+    assert(buf != NULL || len == 0);
+    if (!buf)
+        buf = "";
+    assert(tokens != NULL || capacity == 0);
+
+    Lexer lx     = lexer_init(buf, len);
+    size_t count = 0;
+
+    Token t;
+    while (next_token(&lx, &t))
+    {
+        if (count < capacity)
+            tokens[count] = public_token(t);
+        count++;
+    }
+    return count;
+}
+
+bool scanql_next_statement(const char* buf,
+                           size_t len,
+                           size_t* cursor,
+                           scanql_span* stmt)
+{
+    assert(stmt != NULL);
+
+    StatementRange range;
+    if (!next_statement(buf, len, cursor, &range))
+        return false;
+
+    stmt->offset = range.start;
+    stmt->length = range.len;
+    return true;
+}
+
+void scanql_expected_str(uint64_t expected, char* buf, size_t n)
+{
+    Valid_Symbols e = {expected & ((SYM(END) << 1) - 1)};
+    expected_to_str(e, buf, n);
+}
+
+/*
+ * private_result - ValidationResult with the single error of @result, for
+ * the report printers. @e receives the error and must outlive the result.
+ */
+static ValidationResult private_result(const char* buf,
+                                       size_t len,
+                                       const scanql_result* result,
+                                       ValidationError* e)
+{
+    assert(result != NULL);
+
+    *e = (ValidationError){
+        .token    = {.type = END, .pos = 0, .len = 0},
+        .position = result->error_index,
+        .expected = {result->expected},
+        .message  = "unexpected token",
+    };
+    if (result->error.type < SCANQL_TOKEN_END)
+    {
+        e->token.type = (SqlSymbols)result->error.type;
+        e->token.pos  = result->error.offset;
+        e->token.len  = result->error.length;
+    }
+
+    ValidationResult res = {
+        .ok             = result->ok,
+        .error_count    = result->error_count,
+        .error_capacity = 1,
+        .errors         = e,
+        .sql            = buf,
+        .sql_len        = len,
+    };
+    return res;
+}
+
+void scanql_fprint_result(FILE* out,
+                          const char* buf,
+                          size_t len,
+                          const scanql_result* result,
+                          unsigned flags)
+{
+    ValidationError e;
+    ValidationResult res = private_result(buf, len, result, &e);
+    fprint_validation_result(out, &res, flags & SCANQL_PRINT_COLOR);
+}
+
+size_t scanql_format_result(char* out,
+                            size_t cap,
+                            const char* buf,
+                            size_t len,
+                            const scanql_result* result,
+                            unsigned flags)
+{
+    assert(out != NULL || cap == 0);
+
+    ValidationError e;
+    ValidationResult res = private_result(buf, len, result, &e);
+    TextBuf tb           = {.out = out, .cap = cap};
+    format_validation_result(&tb, &res, flags & SCANQL_PRINT_COLOR, NULL, 0);
+    text_finish(&tb);
+    return tb.len;
+}
+
+struct scanql_lines
+{
+    LineIndex index;
+};
+
+scanql_lines* scanql_lines_new(const char* buf, size_t len)
+{
+    assert(buf != NULL || len == 0);
+    scanql_lines* lines = malloc(sizeof(*lines));
+    if (lines)
+        line_index_init(&lines->index, buf ? buf : "", len);
+    return lines;
+}
+
+void scanql_lines_free(scanql_lines* lines)
+{
+    if (!lines)
+        return;
+    line_index_free(&lines->index);
+    free(lines);
+}
+
+bool scanql_lines_locate(scanql_lines* lines,
+                         size_t offset,
+                         scanql_position* pos)
+{
+    assert(lines != NULL && pos != NULL);
+    if (offset > lines->index.len)
+        offset = lines->index.len;
+
+    size_t line;
+    size_t line_start;
+    if (!line_index_locate(&lines->index, offset, &line, &line_start))
+        return false;
+    pos->line   = line;
+    pos->column = offset - line_start + 1;
+    return true;
+}
+
+size_t scanql_format_result_in(char* out,
+                               size_t cap,
+                               scanql_lines* lines,
+                               scanql_span stmt,
+                               const scanql_result* result,
+                               unsigned flags)
+{
+    assert(out != NULL || cap == 0);
+    assert(lines != NULL);
+    assert(stmt.offset + stmt.length <= lines->index.len);
+
+    ValidationError e;
+    const char* sql      = lines->index.buf + stmt.offset;
+    ValidationResult res = private_result(sql, stmt.length, result, &e);
+    TextBuf tb           = {.out = out, .cap = cap};
+    format_validation_result(
+        &tb, &res, flags & SCANQL_PRINT_COLOR, &lines->index, stmt.offset);
+    text_finish(&tb);
+    return tb.len;
+}
+
+struct scanql_stream
+{
+    StreamValidator sv;
+    scanql_statement_fn fn;
+    void* user;
+};
+
+static void public_stream_result(const StreamResult* r, void* user)
+{
+    scanql_stream* stream = user;
+    scanql_statement stmt = {
+        .index  = r->index,
+        .span   = {r->start, r->end - r->start},
+        .result = {.ok = r->ok},
+    };
+    if (!r->ok)
+    {
+        stmt.result.error_count = 1;
+        stmt.result.error_index = r->error_index;
+        stmt.result.expected    = r->expected.mask;
+        stmt.result.error       = (scanql_token){
+            .type   = (scanql_token_type)r->error_type,
+            .offset = r->error_offset,
+            .length = 0,
+        };
+    }
+    stream->fn(&stmt, stream->user);
+}
+
+scanql_stream* scanql_stream_new(scanql_statement_fn fn, void* user)
+{
+    assert(fn != NULL);
+
+    scanql_stream* stream = malloc(sizeof(*stream));
+    if (!stream)
+        return NULL;
+
+    stream->fn   = fn;
+    stream->user = user;
+    stream_init(&stream->sv, public_stream_result, stream);
+    return stream;
+}
+
+void scanql_stream_feed(scanql_stream* stream, const char* buf, size_t len)
+{
+    stream_feed(&stream->sv, buf, len);
+}
+
+void scanql_stream_finish(scanql_stream* stream)
+{
+    stream_finish(&stream->sv);
+}
+
+void scanql_stream_free(scanql_stream* stream)
+{
+    free(stream);
+}
+
+/*
+ * Verdict cache. A statement is lexed once, and that pass both runs the
+ * grammar up to the first error and fingerprints the token types. Valid
+ * statements are done at that point, and the first error of a failing one
+ * is known too; only its error count, which takes a second pass with error
+ * recovery, comes from the cache. The table is split into buckets of
+ * CACHE_WAYS entries; a fingerprint can only live in the bucket its low bits
+ * select, and a full bucket evicts with its own CLOCK hand. Buckets are
+ * spread over CACHE_SHARDS locks, each of which also keeps the counters of
+ * its buckets.
+ */
+#define CACHE_WAYS 8
+#define CACHE_SHARDS 64
+
+/**
+ * struct CacheEntry - Cached error count of one failing statement shape
+ * @fingerprint: ShapeScan.fingerprint of the statement, 0 for a free entry
+ * @tokens: number of tokens, checked on lookup against collisions
+ * @error_count: errors found with the error limit the entry was made with
+ * @complete: @error_count is the count without any limit
+ * @referenced: CLOCK bit, set on every hit
+ */
+typedef struct
+{
+    uint64_t fingerprint;
+    uint32_t tokens;
+    uint32_t error_count;
+    bool complete;
+    bool referenced;
+} CacheEntry;
+
+typedef struct
+{
+    _Alignas(64) pthread_mutex_t lock;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+} CacheShard;
+
+struct scanql_cache
+{
+    size_t buckets; // power of two
+    CacheEntry* entries;
+    uint8_t* hands;
+    CacheShard shards[CACHE_SHARDS];
+};
+
+/*
+ * shape_class - Token type a statement shape records for @type. The grammar
+ * accepts the three literal types in the same places, so they are one class.
+ */
+static inline SqlSymbols shape_class(SqlSymbols type)
+{
+    if (type == SINGLE_QUOTED_VALUE || type == DOUBLE_QUOTED_VALUE)
+        return NUMBER;
+    return type;
+}
+
+/*
+ * Final avalanche of a 64-bit FNV-1a hash: MurmurHash3's fmix64. The cache
+ * picks buckets by the low bits, which plain FNV-1a mixes poorly.
+ */
+static inline uint64_t hash_finish(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+/**
+ * struct ShapeScan - What one lexing pass learns about a statement
+ * @fingerprint: FNV-1a over the shape_class() of every token with a final
+ *               avalanche, never 0; literals and names only contribute
+ *               their class, so statements that differ in them share it
+ * @tokens: number of tokens
+ * @first: first error, as check_query_with_errors() records it
+ */
+typedef struct
+{
+    uint64_t fingerprint;
+    size_t tokens;
+    ValidationError first;
+} ShapeScan;
+
+/**
+ * shape_scan - Validate up to the first error and fingerprint the shape
+ * @sql: SQL text
+ * @len: bytes in @sql
+ * @scan: receives the fingerprint, token count and first error
+ *
+ * check_query() and the fingerprint fused into a single pass: the grammar
+ * stops at the first error, the hash goes on to the end of the statement.
+ *
+ * Return: true if the statement is valid.
+ */
+static bool shape_scan(const char* sql, size_t len, ShapeScan* scan)
+{
+    Lexer lx           = lexer_init(sql, len);
+    GrammarState state = GRAMMAR_START;
+    bool ok            = true;
+    uint64_t h         = FNV_OFFSET;
+    size_t n           = 0;
+
+    Token t;
+    while (next_token(&lx, &t))
+    {
+        h = (h ^ shape_class(t.type)) * FNV_PRIME;
+        if (ok && grammar_next[state][t.type] == STATE_ERROR)
+        {
+            scan->first = (ValidationError){
+                .token    = t,
+                .position = n,
+                .expected = state_expected(state),
+                .message  = "unexpected token",
+            };
+            ok = false;
+        }
+        else if (ok)
+        {
+            state = grammar_next[state][t.type];
+        }
+        n++;
+    }
+
+    if (ok && n > 0 && grammar_next[state][END] == STATE_ERROR)
+    {
+        scan->first = (ValidationError){
+            .token    = {.type = END},
+            .position = n,
+            .expected = state_expected(state),
+            .message  = "unexpected token",
+        };
+        ok = false;
+    }
+
+    h                 = hash_finish(h ^ n);
+    scan->fingerprint = h ? h : 1;
+    scan->tokens      = n;
+    return ok;
+}
+
+scanql_cache* scanql_cache_new(size_t capacity)
+{
+    size_t buckets = 1;
+    while (buckets * 2 * CACHE_WAYS <= capacity)
+        buckets *= 2;
+
+    scanql_cache* cache = calloc(1, sizeof(*cache));
+    if (!cache)
+        return NULL;
+    cache->buckets = buckets;
+    cache->entries = calloc(buckets * CACHE_WAYS, sizeof(CacheEntry));
+    cache->hands   = calloc(buckets, 1);
+    if (!cache->entries || !cache->hands)
+    {
+        free(cache->hands);
+        free(cache->entries);
+        free(cache);
+        return NULL;
+    }
+
+    for (int i = 0; i < CACHE_SHARDS; i++)
+        pthread_mutex_init(&cache->shards[i].lock, NULL);
+    return cache;
+}
+
+void scanql_cache_free(scanql_cache* cache)
+{
+    if (!cache)
+        return;
+
+    for (int i = 0; i < CACHE_SHARDS; i++)
+        pthread_mutex_destroy(&cache->shards[i].lock);
+    free(cache->hands);
+    free(cache->entries);
+    free(cache);
+}
+
+/* A cached verdict answers a lookup unless its error count was cut short. */
+static bool cache_entry_answers(const CacheEntry* e, size_t error_limit)
+{
+    return e->complete || (error_limit != 0 && error_limit <= e->error_count);
+}
+
+bool scanql_validate_cached(scanql_cache* cache,
+                            const char* buf,
+                            size_t len,
+                            scanql_result* result)
+{
+    assert(buf != NULL || len == 0);
+    assert(result != NULL);
+    if (!buf)
+        buf = "";
+
+    /* With a limit of 1 the first error is all there is to find */
+    size_t limit = result->error_limit;
+    if (!cache || limit == 1)
+        return scanql_validate(buf, len, result);
+
+    *result = (scanql_result){.error_limit = limit, .ok = true};
+    ShapeScan scan;
+    if (shape_scan(buf, len, &scan))
+        return true;
+
+    /* Entries count in 32 bits; larger statements are never cached */
+    uint64_t fp   = scan.fingerprint;
+    size_t tokens = scan.tokens;
+    if (tokens >= UINT32_MAX)
+        return scanql_validate(buf, len, result);
+
+    size_t bucket     = fp & (cache->buckets - 1);
+    CacheShard* shard = &cache->shards[bucket % CACHE_SHARDS];
+    CacheEntry* ways  = &cache->entries[bucket * CACHE_WAYS];
+    CacheEntry found  = {0};
+
+    pthread_mutex_lock(&shard->lock);
+    for (int w = 0; w < CACHE_WAYS; w++)
+    {
+        if (ways[w].fingerprint == fp && ways[w].tokens == tokens &&
+            cache_entry_answers(&ways[w], limit))
+        {
+            ways[w].referenced = true;
+            found              = ways[w];
+            break;
+        }
+    }
+    if (found.fingerprint)
+        shard->hits++;
+    else
+        shard->misses++;
+    pthread_mutex_unlock(&shard->lock);
+
+    if (found.fingerprint)
+    {
+        size_t count = found.error_count;
+        public_failure(result,
+                       &scan.first,
+                       limit && limit < count ? limit : count,
+                       len);
+        return false;
+    }
+
+    /* A miss counts the errors with recovery, as scanql_validate() does */
+    ValidationError first;
+    ValidationResult res = {
+        .ok             = true,
+        .error_capacity = 1,
+        .errors         = &first,
+        .error_limit    = limit,
+    };
+    check_query_with_errors(buf, len, &res);
+    public_failure(result, &scan.first, res.error_count, len);
+
+    CacheEntry e = {
+        .fingerprint = fp,
+        .tokens      = (uint32_t)tokens,
+        .error_count = (uint32_t)res.error_count,
+        .complete    = limit == 0 || res.error_count < limit,
+    };
+
+    /* Refresh an entry of the same shape, else take a free one or evict */
+    pthread_mutex_lock(&shard->lock);
+    int slot = -1;
+    for (int w = 0; w < CACHE_WAYS && slot < 0; w++)
+        if (ways[w].fingerprint == fp && ways[w].tokens == tokens)
+            slot = w;
+    for (int w = 0; w < CACHE_WAYS && slot < 0; w++)
+        if (ways[w].fingerprint == 0)
+        {
+            slot = w;
+            shard->entries++;
+        }
+    while (slot < 0)
+    {
+        uint8_t* hand      = &cache->hands[bucket];
+        CacheEntry* victim = &ways[*hand];
+        *hand              = (uint8_t)((*hand + 1) % CACHE_WAYS);
+        if (victim->referenced)
+            victim->referenced = false;
+        else
+        {
+            slot = (int)(victim - ways);
+            shard->evictions++;
+        }
+    }
+    ways[slot] = e;
+    pthread_mutex_unlock(&shard->lock);
+
+    return false;
+}
+
+void scanql_cache_stats_get(const scanql_cache* cache,
+                            scanql_cache_stats* stats)
+{
+    *stats = (scanql_cache_stats){
+        .capacity = cache->buckets * CACHE_WAYS,
+    };
+
+    for (int i = 0; i < CACHE_SHARDS; i++)
+    {
+        /* The locks are only taken to read consistent counters */
+        CacheShard* shard = (CacheShard*)&cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->evictions += shard->evictions;
+        stats->entries += shard->entries;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+/*
+ * Statement templates. template_push() is fed every token as the lexer
+ * produces it and extends both the normalized text and the template hash,
+ * so a statement is normalized in the same pass that lexes it.
+ */
+
+/* Canonical text of every token type; identifiers keep their own bytes */
+static const char* const template_text[END] = {
+    [SELECT]               = "SELECT",
+    [FROM]                 = "FROM",
+    [WHERE]                = "WHERE",
+    [UPDATE]               = "UPDATE",
+    [DELETE]               = "DELETE",
+    [INSERT]               = "INSERT",
+    [INTO]                 = "INTO",
+    [VALUES]               = "VALUES",
+    [SET]                  = "SET",
+    [JOIN]                 = "JOIN",
+    [CREATE]               = "CREATE",
+    [TABLE]                = "TABLE",
+    [COMMA]                = ",",
+    [SEMICOLON]            = ";",
+    [EQUALS]               = "=",
+    [STAR]                 = "*",
+    [NUMBER]               = "?",
+    [DOUBLE_QUOTED_VALUE]  = "?",
+    [SINGLE_QUOTED_VALUE]  = "?",
+    [SQL_IDENTIFIER]       = NULL,
+    [AND]                  = "AND",
+    [OR]                   = "OR",
+    [ROUND_BRACKETS_OPEN]  = "(",
+    [ROUND_BRACKETS_CLOSE] = ")",
+};
+
+/**
+ * struct Template - Normalized text and hash of a statement being lexed
+ * @hash: FNV-1a state over the token classes and the length and bytes of
+ *        every identifier
+ * @text: normalized text so far
+ * @tokens: tokens pushed so far
+ * @prev: type of the previous token
+ */
+typedef struct
+{
+    uint64_t hash;
+    TextBuf text;
+    size_t tokens;
+    SqlSymbols prev;
+} Template;
+
+static inline void template_push(Template* tpl, const char* sql, Token t)
+{
+    SqlSymbols type = t.type;
+    tpl->hash       = (tpl->hash ^ shape_class(type)) * FNV_PRIME;
+
+    if (tpl->tokens > 0 && type != COMMA && type != SEMICOLON &&
+        type != ROUND_BRACKETS_CLOSE && tpl->prev != ROUND_BRACKETS_OPEN)
+        text_put(&tpl->text, " ", 1);
+
+    if (type == SQL_IDENTIFIER)
+    {
+        /*
+         * Identifiers may hold any byte that is not a break, including the
+         * values of token classes; their length goes first so that the
+         * hashed sequence has only one reading.
+         */
+        const unsigned char* id = (const unsigned char*)sql + t.pos;
+        tpl->hash = (tpl->hash ^ t.len) * FNV_PRIME;
+        for (size_t i = 0; i < t.len; i++)
+            tpl->hash = (tpl->hash ^ id[i]) * FNV_PRIME;
+        text_put(&tpl->text, sql + t.pos, t.len);
+    }
+    else
+    {
+        text_puts(&tpl->text, template_text[type]);
+    }
+
+    tpl->prev = type;
+    tpl->tokens++;
+}
+
+void scanql_normalize(const char* buf,
+                      size_t len,
+                      char* out,
+                      size_t cap,
+                      scanql_template* tpl)
+{
+    assert(buf != NULL || len == 0);
+    assert(out != NULL || cap == 0);
+    assert(tpl != NULL);
+    if (!buf)
+        buf = "";
+
+    Template b = {
+        .hash = FNV_OFFSET,
+        .text = {.out = out, .cap = cap},
+        .prev = END,
+    };
+    Lexer lx = lexer_init(buf, len);
+
+    Token t;
+    while (next_token(&lx, &t))
+        template_push(&b, buf, t);
+
+    text_finish(&b.text);
+    tpl->id     = hash_finish(b.hash ^ b.tokens);
+    tpl->length = b.text.len;
+    tpl->tokens = b.tokens;
+}
+
+/*
+ * Validation profiles. scanql_validate_profiled() takes the two-pass route
+ * of get_tokens() and validate_query_with_errors() so that lexing and
+ * validation can be timed apart; the fused scanql_validate() path carries
+ * no counters at all.
+ */
+struct scanql_profile
+{
+    Arena arena;
+    scanql_stats stats;
+};
+
+/* profile_now - Monotonic clock in nanoseconds */
+static uint64_t profile_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+scanql_profile* scanql_profile_new(void)
+{
+    return calloc(1, sizeof(scanql_profile));
+}
+
+void scanql_profile_free(scanql_profile* profile)
+{
+    if (!profile)
+        return;
+    arena_free(&profile->arena);
+    free(profile);
+}
+
+bool scanql_validate_profiled(scanql_profile* profile,
+                              const char* buf,
+                              size_t len,
+                              scanql_result* result)
+{
+    assert(profile != NULL);
+    assert(buf != NULL || len == 0);
+    assert(result != NULL);
+    if (!buf)
+        buf = "";
+
+    size_t limit = result->error_limit;
+    *result      = (scanql_result){.error_limit = limit, .ok = true};
+    arena_reset(&profile->arena);
+
+    scanql_stats* st = &profile->stats;
+    st->statements++;
+    st->bytes += len;
+
+    uint64_t t0      = profile_now();
+    TokenStack stack = get_tokens(buf, len, &profile->arena);
+    uint64_t t1      = profile_now();
+
+    /* Out of memory mid-lex: the stack is only a prefix of the input */
+    if (stack.truncated)
+    {
+        bool ok = scanql_validate(buf, len, result);
+        if (!ok)
+            st->failed++;
+        return ok;
+    }
+
+    ValidationResult res =
+        validation_result_init(&profile->arena, limit, stack.len);
+    validate_query_with_errors(&stack, &res);
+    uint64_t t2 = profile_now();
+
+    st->tokens += stack.len;
+    for (size_t i = 0; i < stack.len; i++)
+        st->tokens_by_type[stack.types[i]]++;
+    st->lex_ns += t1 - t0;
+    st->validate_ns += t2 - t1;
+    st->errors_recorded += res.error_count;
+    st->errors_stored += res.error_count < res.error_capacity
+                             ? res.error_count
+                             : res.error_capacity;
+
+    if (res.ok)
+        return true;
+    st->failed++;
+
+    /* Without an error buffer the errors were only counted */
+    if (res.error_capacity == 0)
+        return scanql_validate(buf, len, result);
+    public_failure(result, &res.errors[0], res.error_count, len);
+    return false;
+}
+
+void scanql_profile_stats(const scanql_profile* profile, scanql_stats* stats)
+{
+    *stats                = profile->stats;
+    stats->arena_used     = profile->arena.high_water;
+    stats->arena_capacity = profile->arena.capacity;
+}
+
+// NOTE: for developing tests and triggering treesitter to highlight
+//<-- test dev-->
+// #define TEST_MODE false
+// #if TEST_MODE
+//<-- test dev-->
+
+#if defined(TEST_MODE)
+
+/* Backing store for make_stack(); lives until the test run ends */
+static Arena test_arena;
+
+/**
+ * make_stack - Pack a Token array into a TokenStack
+ * @toks: array of tokens
+ * @len: number of elements in @toks
+ *
+ * Return: TokenStack whose arrays live in test_arena.
+ */
+static TokenStack make_stack(Token* toks, int len)
+{
+    TokenStack s = token_stack_init(&test_arena);
+    for (int i = 0; i < len; i++)
+        append(&s, toks[i]);
+    return s;
+}
+
+/**
+ * make_token - Construct a one-byte Token at the given offset
+ * @pos: byte offset of the lexeme
+ * @type: SqlSymbols type tag
+ *
+ * Return: initialized Token.
+ */
+static Token make_token(int pos, SqlSymbols type)
+{
+    Token t = {.type = type, .pos = pos, .len = 1};
+    return t;
+}
+
+/**
+ * lexeme_is - Compare the source bytes a token points at with a string
+ * @sql: SQL source the token was produced from
+ * @t: token to check
+ * @expected: expected lexeme
+ *
+ * Return: true if the token's lexeme equals @expected.
+ */
+static bool lexeme_is(const char* sql, Token t, const char* expected)
+{
+    return (size_t)t.len == strlen(expected) &&
+           strncmp(sql + t.pos, expected, (size_t)t.len) == 0;
+}
+
+/**
+ * test_append_increments_len_until_capacity - append fills the stack in order
+ */
+static void test_append_increments_len_until_capacity(void)
+{
+    uint8_t types[3];
+    uint32_t offsets[3];
+    uint32_t ends[3];
+    TokenStack s = {
+        .types   = types,
+        .offsets = offsets,
+        .ends    = ends,
+        .len     = 0,
+        .cap     = 3,
+    };
+
+    append(&s, make_token(0, SQL_IDENTIFIER));
+    append(&s, make_token(2, SQL_IDENTIFIER));
+    append(&s, make_token(4, SQL_IDENTIFIER));
+
+    assert(s.len == 3);
+    assert(!s.truncated);
+    assert(s.offsets[0] == 0);
+    assert(s.offsets[1] == 2);
+    assert(s.offsets[2] == 4);
+}
+
+/**
+ * test_append_does_not_overflow_capacity - append beyond capacity is dropped
+ * and marks the stack truncated
+ */
+static void test_append_does_not_overflow_capacity(void)
+{
+    uint8_t types[2];
+    uint32_t offsets[2];
+    uint32_t ends[2];
+    TokenStack s = {
+        .types   = types,
+        .offsets = offsets,
+        .ends    = ends,
+        .len     = 0,
+        .cap     = 2,
+    };
+
+    append(&s, make_token(0, SQL_IDENTIFIER));
+    append(&s, make_token(2, SQL_IDENTIFIER));
+    assert(!s.truncated);
+    /* This should be ignored because len == cap */
+    append(&s, make_token(4, SQL_IDENTIFIER));
+
+    assert(s.len == 2);
+    assert(s.truncated);
+    assert(s.offsets[0] == 0);
+    assert(s.offsets[1] == 2);
+}
+
+/**
+ * test_append_marks_failed_epoch_truncated - A token past 4 GiB that cannot
+ * record its epoch is dropped and marks the stack truncated
+ */
+static void test_append_marks_failed_epoch_truncated(void)
+{
+    uint8_t types[2];
+    uint32_t offsets[2];
+    uint32_t ends[2];
+    TokenStack s = {
+        .types   = types,
+        .offsets = offsets,
+        .ends    = ends,
+        .len     = 0,
+        .cap     = 2,
+    };
+
+    append(&s, make_token(0, SQL_IDENTIFIER));
+    Token far = {.type = SQL_IDENTIFIER, .pos = (size_t)1 << 32, .len = 1};
+    append(&s, far);
+
+    assert(s.len == 1);
+    assert(s.truncated);
+}
+
+/**
+ * test_token_stack_grows_in_arena - An arena-backed stack grows as tokens
+ * arrive and keeps every token
+ */
+static void test_token_stack_grows_in_arena(void)
+{
+    Arena arena  = {0};
+    TokenStack s = token_stack_init(&arena);
+    assert(s.cap == 0);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        Token t = {.type = i % 2 ? NUMBER : COMMA, .pos = i, .len = i % 7};
+        append(&s, t);
+    }
+
+    assert(s.len == 1000);
+    assert(s.cap >= 1000);
+    for (size_t i = 0; i < 1000; i++)
+    {
+        Token t = token_at(&s, i);
+        assert(t.type == (i % 2 ? NUMBER : COMMA));
+        assert(t.pos == i && t.len == i % 7);
+    }
+
+    arena_free(&arena);
+}
+
+/**
+ * test_append_null_stack_is_safe - append to NULL stack must not crash
+ */
+static void test_append_null_stack_is_safe(void)
+{
+    append(NULL, make_token(0, SQL_IDENTIFIER));
+}
+
+/**
+ * test_arena_grows_by_linking_blocks - Allocations past the first block land
+ * in new blocks and earlier slices stay where they are
+ */
+static void test_arena_grows_by_linking_blocks(void)
+{
+    Arena arena = {0};
+
+    unsigned char* first = arena_alloc(&arena, 100);
+    assert(first != NULL);
+    memset(first, 0xab, 100);
+    assert(((uintptr_t)first % ARENA_ALIGN) == 0);
+
+    unsigned char* big = arena_alloc(&arena, 3 * ARENA_MIN_BLOCK);
+    assert(big != NULL);
+    memset(big, 0xcd, 3 * ARENA_MIN_BLOCK);
+    assert(arena.head != arena.current);
+    assert(first[99] == 0xab);
+
+    unsigned char* small = arena_alloc(&arena, 1);
+    assert(small != NULL);
+    assert(((uintptr_t)small % ARENA_ALIGN) == 0);
+    assert(arena.used >= 100 + 3 * ARENA_MIN_BLOCK + 1);
+
+    arena_free(&arena);
+    assert(arena.head == NULL && arena.capacity == 0);
+}
+
+/**
+ * test_arena_reset_reuses_blocks - After a reset the same blocks serve the
+ * next round, and the high-water mark survives
+ */
+static void test_arena_reset_reuses_blocks(void)
+{
+    Arena arena = arena_init(1024);
+
+    for (int round = 0; round < 3; round++)
+    {
+        arena_reset(&arena);
+        assert(arena.used == 0);
+        assert(arena_alloc(&arena, 512) != NULL);
+        assert(arena_alloc(&arena, 4 * ARENA_MIN_BLOCK) != NULL);
+    }
+    size_t capacity = arena.capacity;
+    size_t peak     = arena.high_water;
+    assert(peak >= 512 + 4 * ARENA_MIN_BLOCK);
+
+    arena_reset(&arena);
+    assert(arena_alloc(&arena, 16) != NULL);
+    assert(arena.capacity == capacity);
+    assert(arena.high_water == peak);
+
+    /* Rewinding drops only what came after the mark */
+    ArenaMark mark = arena_mark(&arena);
+    void* a        = arena_alloc(&arena, 2 * ARENA_MIN_BLOCK);
+    arena_rewind(&arena, mark);
+    assert(arena.used == 16);
+    assert(arena_alloc(&arena, 2 * ARENA_MIN_BLOCK) == a);
+
+    arena_free(&arena);
+}
+
+/**
+ * test_arena_huge_block - Blocks of ARENA_HUGE_BLOCK bytes and more are
+ * usable end to end
+ */
+static void test_arena_huge_block(void)
+{
+    Arena arena = {0};
+    size_t size = ARENA_HUGE_BLOCK + 1;
+
+    unsigned char* p = arena_alloc(&arena, size);
+    assert(p != NULL);
+    p[0]        = 1;
+    p[size - 1] = 2;
+    assert(arena.capacity >= size);
+
+    arena_free(&arena);
+}
+
+/**
+ * test_report_formats_errors - smoke-test that the printer handles a real error
+ * result without crashing and renders at least one error line.
+ */
+static void test_report_formats_errors(void)
+{
+    Token toks[] = {
+        {.type = FROM}, /* invalid start */
+        {.type = SELECT},
+        {.type = FROM},
+        {.type = SQL_IDENTIFIER},
+        {.type = SEMICOLON},
+    };
+    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
+
+    ValidationError errs[8];
+    ValidationResult res = {.errors = errs, .error_capacity = 8};
+    bool ok              = validate_query_with_errors(&s, &res);
+
+    assert(!ok);
+    assert(res.error_count >= 1);
+
+    /* Smoke-test the printer (no assertions on stdout content) */
+    print_validation_result(&res);
+}
+
+/*
+ * osa_distance - Textbook restricted Damerau-Levenshtein distance by dynamic
+ * programming, case-insensitive; the reference for edit_distance()
+ */
+static size_t osa_distance(const char* a, size_t n, const char* b, size_t m)
+{
+    char x[8];
+    char y[8];
+    size_t d[8][8];
+    assert(n < 8 && m < 8);
+    for (size_t i = 0; i < n; i++)
+        x[i] = (char)tolower((unsigned char)a[i]);
+    for (size_t j = 0; j < m; j++)
+        y[j] = (char)tolower((unsigned char)b[j]);
+
+    for (size_t i = 0; i <= n; i++)
+        d[i][0] = i;
+    for (size_t j = 0; j <= m; j++)
+        d[0][j] = j;
+
+    for (size_t i = 1; i <= n; i++)
+    {
+        for (size_t j = 1; j <= m; j++)
+        {
+            size_t best = d[i - 1][j - 1] + (x[i - 1] != y[j - 1]);
+            if (d[i - 1][j] + 1 < best)
+                best = d[i - 1][j] + 1;
+            if (d[i][j - 1] + 1 < best)
+                best = d[i][j - 1] + 1;
+            if (i > 1 && j > 1 && x[i - 1] == y[j - 2] &&
+                x[i - 2] == y[j - 1] && d[i - 2][j - 2] + 1 < best)
+                best = d[i - 2][j - 2] + 1;
+            d[i][j] = best;
+        }
+    }
+    return d[n][m];
+}
+
+/**
+ * test_edit_distance_matches_reference - The bit-parallel distance agrees
+ * with dynamic programming on every pair of short strings over a small
+ * alphabet, where repeats and transpositions are frequent
+ */
+static void test_edit_distance_matches_reference(void)
+{
+    /* Every string of up to 5 letters from "abC" */
+    char words[1 + 3 + 9 + 27 + 81 + 243][6];
+    size_t count = 0;
+    for (size_t len = 0; len <= 5; len++)
+    {
+        size_t total = 1;
+        for (size_t i = 0; i < len; i++)
+            total *= 3;
+        for (size_t k = 0; k < total; k++, count++)
+        {
+            size_t v = k;
+            for (size_t i = 0; i < len; i++, v /= 3)
+                words[count][i] = "abC"[v % 3];
+            words[count][len] = '\0';
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        EditPattern p;
+        edit_pattern_init(&p, words[i], strlen(words[i]));
+        for (size_t j = 0; j < count; j++)
+        {
+            size_t n = strlen(words[j]);
+            assert(edit_distance(&p, words[j], n) ==
+                   osa_distance(words[i], p.len, words[j], n));
+        }
+    }
+
+    /* Case is ignored and the pattern may fill the whole word */
+    char a[65];
+    memset(a, 'x', 64);
+    a[64] = '\0';
+    EditPattern p;
+    edit_pattern_init(&p, a, 64);
+    assert(edit_distance(&p, "XXXX", 4) == 60);
+    a[10] = 'y';
+    assert(edit_distance(&p, a, 64) == 1);
+}
+
+/**
+ * test_report_formats_new_symbols - smoke-test that symbol_to_str covers
+ * every token type reachable from the current enum (UPDATE, JOIN, etc.).
+ */
+static void test_report_formats_new_symbols(void)
+{
+    /* Manually craft a result using newly added symbols to exercise
+     * symbol_to_str */
+    ValidationError errs[2];
+    errs[0].token    = (Token){.type = UPDATE};
+    errs[0].position = 0;
+    errs[0].expected = (Valid_Symbols){SYM(SELECT)}; /* arbitrary state */
+    errs[0].message  = "unexpected token";
+
+    errs[1].token    = (Token){.type = JOIN};
+    errs[1].position = 1;
+    errs[1].expected = (Valid_Symbols){SYM(SQL_IDENTIFIER)};
+    errs[1].message  = "unexpected token";
+
+    ValidationResult res = {
+        .ok             = false,
+        .error_count    = 2,
+        .error_capacity = 2,
+        .errors         = errs,
+    };
+
+    /* Smoke-test that printer handles new enum entries without falling back to
+     * '?' */
+    print_validation_result(&res);
+}
+
+/**
+ * test_expected_to_str_renders_mask - Expected sets are read from the grammar
+ * table and render every accepted token once, in enum order
+ */
+static void test_expected_to_str_renders_mask(void)
+{
+    char buf[256];
+
+    expected_to_str(state_expected(STATE_SELECT), buf, sizeof(buf));
+    assert(strcmp(buf, "STAR | SQL_IDENTIFIER") == 0);
+
+    expected_to_str(state_expected(STATE_COLUMN_TYPE), buf, sizeof(buf));
+    assert(strcmp(buf, "COMMA | ROUND_BRACKETS_CLOSE") == 0);
+
+    expected_to_str(state_expected(STATE_TABLE), buf, sizeof(buf));
+    assert(strcmp(buf, "SQL_IDENTIFIER") == 0);
+
+    expected_to_str(state_expected(GRAMMAR_START), buf, sizeof(buf));
+    assert(strcmp(buf, "SELECT | UPDATE | DELETE | INSERT | CREATE") == 0);
+
+    expected_to_str(state_expected(STATE_ERROR), buf, sizeof(buf));
+    assert(strcmp(buf, "") == 0);
+}
+
+/**
+ * test_grammar_table_is_dense_and_aligned - Every row has room for every
+ * token class and the table starts on a cache line
+ */
+static void test_grammar_table_is_dense_and_aligned(void)
+{
+    assert((uintptr_t)grammar_next % 64 == 0);
+    assert(sizeof(grammar_next[0]) == TOKEN_CLASS_COUNT);
+    assert(sizeof(grammar_next) / sizeof(grammar_next[0]) == STATE_COUNT);
+
+    /* The error row rejects everything, including the end of input */
+    for (int tok = 0; tok < TOKEN_CLASS_COUNT; tok++)
+        assert(grammar_next[STATE_ERROR][tok] == STATE_ERROR);
+}
+
+/**
+ * test_grammar_literals_are_interchangeable - Numbers and quoted values are
+ * accepted in the same places and allow the same successors, which the
+ * verdict cache relies on
+ */
+static void test_grammar_literals_are_interchangeable(void)
+{
+    for (int state = 0; state < STATE_COUNT; state++)
+    {
+        bool number = grammar_next[state][NUMBER] != STATE_ERROR;
+        assert(number == (grammar_next[state][SINGLE_QUOTED_VALUE] !=
+                          STATE_ERROR));
+        assert(number == (grammar_next[state][DOUBLE_QUOTED_VALUE] !=
+                          STATE_ERROR));
+    }
+    assert(memcmp(grammar_next[STATE_NUMBER],
+                  grammar_next[STATE_SINGLE_QUOTED_VALUE],
+                  sizeof(grammar_next[0])) == 0);
+    assert(memcmp(grammar_next[STATE_NUMBER],
+                  grammar_next[STATE_DOUBLE_QUOTED_VALUE],
+                  sizeof(grammar_next[0])) == 0);
+}
+
+/**
+ * test_create_table_column_list - Identifiers, commas and brackets take on
+ * their column-list roles inside CREATE TABLE only
+ */
+static void test_create_table_column_list(void)
+{
+    const char* valid   = "CREATE TABLE t (id INT, name TEXT);";
+    const char* invalid = "CREATE TABLE t (id, name TEXT);";
+
+    Arena arena = arena_init(arena_capacity_for(strlen(valid)));
+    TokenStack toks = get_tokens(valid, strlen(valid), &arena);
+    assert(validate_query(&toks));
+
+    arena_reset(&arena);
+    toks = get_tokens(invalid, strlen(invalid), &arena);
+    ValidationError errs[16];
+    ValidationResult res = {.errors = errs, .error_capacity = 16};
+    assert(!validate_query_with_errors(&toks, &res));
+    /* The comma after the column name is the first error */
+    assert(res.errors[0].position == 5);
+    assert(res.errors[0].expected.mask == SYM(SQL_IDENTIFIER));
+
+    arena_free(&arena);
+}
+
+/**
+ * test_valid_simple_select_star - Validate SELECT *,identifier FROM
+ */
+static void test_valid_simple_select_star(void)
+{
+    Token toks[] = {
+        {.type = SELECT},
+        {.type = STAR},
+        {.type = COMMA},
+        {.type = SQL_IDENTIFIER},
+        {.type = FROM},
+        {.type = SQL_IDENTIFIER},
+        {.type = SEMICOLON},
+    };
+    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
+    assert(validate_query(&s));
+}
+
+/**
+ * test_valid_where_and_or - Validate WHERE with AND/OR chain
+ */
+static void test_valid_where_and_or(void)
+{
+    Token toks[] = {
+        {.type = SELECT},
+        {.type = SQL_IDENTIFIER},
+        {.type = FROM},
+        {.type = SQL_IDENTIFIER},
+        {.type = WHERE},
+        {.type = SQL_IDENTIFIER},
+        {.type = EQUALS},
+        {.type = SINGLE_QUOTED_VALUE},
+        {.type = AND},
+        {.type = SQL_IDENTIFIER},
+        {.type = EQUALS},
+        {.type = NUMBER},
+        {.type = SEMICOLON},
+    };
+    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
+    assert(validate_query(&s));
+}
+
+/**
+ * test_invalid_missing_from - Ensure missing FROM is rejected
+ */
+static void test_invalid_missing_from(void)
+{
+    Token toks[] = {
+        {.type = SELECT},
+        {.type = SQL_IDENTIFIER},
+        {.type = SQL_IDENTIFIER},
+        {.type = SEMICOLON},
+    };
+    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
+    ValidationError errs[8];
+    ValidationResult res = {.errors = errs, .error_capacity = 8};
+    assert(!validate_query_with_errors(&s, &res));
+    assert(res.error_count >= 1);
+}
+
+/**
+ * test_invalid_trailing_after_semicolon - Ensure trailing tokens after ';' fail
+ */
+static void test_invalid_trailing_after_semicolon(void)
+{
+    Token toks[] = {
+        {.type = SELECT},
+        {.type = SQL_IDENTIFIER},
+        {.type = FROM},
+        {.type = SQL_IDENTIFIER},
+        {.type = SEMICOLON},
+        {.type = SQL_IDENTIFIER},
+    };
+    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
+    ValidationError errs[8];
+    ValidationResult res = {.errors = errs, .error_capacity = 8};
+    assert(!validate_query_with_errors(&s, &res));
+    assert(res.error_count >= 1);
+}
+
+/**
+ * test_accumulates_multiple_errors - Ensure multiple mismatches are collected
+ */
+static void test_accumulates_multiple_errors(void)
+{
+    Token toks[] = {
+        {.type = FROM}, /* wrong start */
+        {.type = SELECT},
+        {.type = FROM}, /* missing select item before FROM */
+        {.type = SQL_IDENTIFIER},
+        {.type = WHERE},
+        {.type = EQUALS}, /* missing lhs */
+        {.type = NUMBER},
+        {.type = SEMICOLON},
+    };
+    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
+    ValidationError errs[16];
+    ValidationResult res = {.errors = errs, .error_capacity = 16};
+    bool ok              = validate_query_with_errors(&s, &res);
+    assert(!ok);
+    assert(res.error_count >= 2);
+}
+
+/**
+ * test_error_limit_stops_early - Validation returns once error_limit errors
+ * were recorded
+ */
+static void test_error_limit_stops_early(void)
+{
+    Token toks[] = {
+        {.type = FROM},
+        {.type = SELECT},
+        {.type = FROM},
+        {.type = SQL_IDENTIFIER},
+        {.type = WHERE},
+        {.type = EQUALS},
+        {.type = NUMBER},
+        {.type = SEMICOLON},
+    };
+    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
+    ValidationError errs[16];
+
+    /* FROM is skipped up to SELECT, the second FROM up to the ';' */
+    ValidationResult all = {.errors = errs, .error_capacity = 16};
+    assert(!validate_query_with_errors(&s, &all));
+    assert(all.error_count == 2);
+    assert(all.errors[1].position == 2);
+
+    for (size_t limit = 1; limit <= 2; limit++)
+    {
+        ValidationResult res = {
+            .errors         = errs,
+            .error_capacity = 16,
+            .error_limit    = limit,
+        };
+        assert(!validate_query_with_errors(&s, &res));
+        assert(res.error_count == limit);
+        assert(res.errors[0].position == 0);
+    }
+
+    /* The arena-backed buffer is sized by the limit */
+    Arena arena          = {0};
+    ValidationResult res = validation_result_init(&arena, 1, 1000);
+    assert(res.error_capacity == 1);
+    res = validation_result_init(&arena, 0, 8);
+    assert(res.error_capacity == 9);
+    assert(!validate_query_with_errors(&s, &res));
+    assert(res.error_count == all.error_count);
+    arena_free(&arena);
+}
+
+/**
+ * test_recovery_resyncs_at_statement_boundaries - After an error, tokens up
+ * to the next ';' or statement keyword report nothing, and parsing resumes
+ * there
+ */
+static void test_recovery_resyncs_at_statement_boundaries(void)
+{
+    const struct
+    {
+        const char* sql;
+        size_t errors;
+        size_t second; // token index of the second error
+    } cases[] = {
+        {"FROM users WHERE id = 1 AND x = 2;", 1, 0},
+        {"SELECT a FROM WHERE x = 1", 1, 0}, // no error for the early end
+        {"SELECT a FROM;", 1, 0},
+        {"SELECT a FROM t; SELECT b FROM u;", 1, 0},
+        {"SELECT FROM t; x", 2, 4},
+        {"SELECT = FROM t SELECT b FROM u WHERE = 1;", 2, 9},
+        {"DELETE t; INSERT INTO t VALUES (1, 2);", 2, 3},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        const char* sql = cases[i].sql;
+        Arena arena     = {0};
+        TokenStack toks = get_tokens(sql, strlen(sql), &arena);
+
+        ValidationError errs[8];
+        ValidationResult res = {.errors = errs, .error_capacity = 8};
+        assert(!validate_query_with_errors(&toks, &res));
+        assert(res.error_count == cases[i].errors);
+        if (res.error_count > 1)
+            assert(errs[1].position == cases[i].second);
+        arena_free(&arena);
+    }
+
+    /* One broken clause costs one error however long the statement is */
+    TextBuf sql = {.cap = 256 * 1024};
+    sql.out     = malloc(sql.cap);
+    assert(sql.out != NULL);
+    text_puts(&sql, "SELECT a FROM t WHERE = 1");
+    for (int i = 0; i < 10000; i++)
+        text_puts(&sql, " AND b = 2");
+    text_puts(&sql, "; SELECT c FROM u");
+    assert(sql.len < sql.cap);
+
+    ValidationError errs[8];
+    ValidationResult res = {.errors = errs, .error_capacity = 8};
+    assert(!check_query_with_errors(sql.out, sql.len, &res));
+    assert(res.error_count == 2);
+    assert(errs[0].token.type == EQUALS && errs[1].token.type == SELECT);
+    free(sql.out);
+}
+
+/**
+ * test_check_query_with_errors_matches_validator - The fused pass records the
+ * same errors as the two-pass pipeline
+ */
+static void test_check_query_with_errors_matches_validator(void)
+{
+    const char* queries[] = {
+        "",
+        "SELECT a FROM t;",
+        "SELECT FROM t;",
+        "FROM users WHERE id = 1;",
+        "CREATE TABLE t (id, name TEXT);",
+        "INSERT INTO t VALUES (1",
+        "SELECT a FROM t; DROP",
+        "WHERE = = ; , FROM",
+    };
+
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++)
+    {
+        const char* sql = queries[i];
+        Arena arena     = {0};
+        TokenStack toks = get_tokens(sql, strlen(sql), &arena);
+
+        ValidationError ref_errs[32];
+        ValidationError errs[32];
+        ValidationResult ref = {.errors = ref_errs, .error_capacity = 32};
+        ValidationResult res = {.errors = errs, .error_capacity = 32};
+
+        bool ok = validate_query_with_errors(&toks, &ref);
+        assert(check_query_with_errors(sql, strlen(sql), &res) == ok);
+        assert(res.error_count == ref.error_count);
+        for (size_t e = 0; e < res.error_count; e++)
+        {
+            assert(errs[e].position == ref_errs[e].position);
+            assert(errs[e].token.type == ref_errs[e].token.type);
+            assert(errs[e].token.pos == ref_errs[e].token.pos);
+            assert(errs[e].expected.mask == ref_errs[e].expected.mask);
+        }
+
+        /* Fail-fast reports the first of those errors */
+        ValidationResult first = {
+            .errors         = errs,
+            .error_capacity = 32,
+            .error_limit    = 1,
+        };
+        assert(check_query_with_errors(sql, strlen(sql), &first) == ok);
+        assert(first.error_count == (ok ? 0 : 1));
+        if (!ok)
+            assert(errs[0].position == ref_errs[0].position);
+
+        arena_free(&arena);
+    }
+}
+
+/**
+ * test_invalid_token_aborts_early - Invalid lexeme should halt validation
+ */
+static void test_invalid_token_aborts_early(void)
+{
+    Token toks[] = {
+        {.type = SELECT},
+        {.type = SQL_IDENTIFIER},
+        {.type = FROM},
+        {.type = SQL_IDENTIFIER},
+        {.type = ROUND_BRACKETS_OPEN}, /* unsupported token */
+        {.type = SEMICOLON},
+    };
+    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
+    ValidationError errs[8];
+    ValidationResult res = {.errors = errs, .error_capacity = 8};
+    bool ok              = validate_query_with_errors(&s, &res);
+
+    assert(!ok);
+    assert(res.error_count >= 1);
+}
+
+/**
+ * test_invalid_new_keyword_token - Newly added keyword should also be rejected
+ * by validator
+ */
+static void test_invalid_new_keyword_token(void)
+{
+    Token toks[] = {
+        {.type = UPDATE}, /* not supported by validator */
+        {.type = SQL_IDENTIFIER},
+        {.type = SET},
+        {.type = SQL_IDENTIFIER},
+        {.type = EQUALS},
+        {.type = NUMBER},
+        {.type = SEMICOLON},
+    };
+    TokenStack s = make_stack(toks, (int)(sizeof(toks) / sizeof(toks[0])));
+    ValidationError errs[8];
+    ValidationResult res = {.errors = errs, .error_capacity = 8};
+    bool ok              = validate_query_with_errors(&s, &res);
+
+    assert(ok); // Now UPDATE is supported, so it should be valid
+}
+
+/**
+ * test_tokenizes_basic_select - Ensure tokenizer produces expected tokens
+ */
+static void test_tokenizes_basic_select(void)
+{
+    const char* sql = "SELECT name,age FROM users;";
+    size_t sql_len  = strlen(sql);
+    Arena arena     = arena_init(arena_capacity_for(sql_len));
+    TokenStack toks = get_tokens(sql, sql_len, &arena);
+
+    assert(toks.len == 7);
+    assert(toks.types[0] == SELECT);
+    assert(lexeme_is(sql, token_at(&toks, 1), "name"));
+    assert(toks.types[2] == COMMA);
+    assert(lexeme_is(sql, token_at(&toks, 3), "age"));
+    assert(toks.types[4] == FROM);
+    assert(lexeme_is(sql, token_at(&toks, 5), "users"));
+    assert(toks.types[6] == SEMICOLON);
+
+    arena_free(&arena);
+}
+
+/**
+ * test_tokens_are_views_into_source - Tokens reference the input instead of
+ * copying lexemes into the arena
+ */
+static void test_tokens_are_views_into_source(void)
+{
+    const char* sql = "insert INTO t VALUES ('it is', \"x\", 42);";
+    size_t sql_len  = strlen(sql);
+    Arena arena     = arena_init(arena_capacity_for(sql_len));
+    TokenStack toks = get_tokens(sql, sql_len, &arena);
+
+    assert(toks.len == 12);
+    assert(toks.types[0] == INSERT);
+    assert(lexeme_is(sql, token_at(&toks, 0), "insert"));
+    assert(toks.types[5] == SINGLE_QUOTED_VALUE);
+    assert(lexeme_is(sql, token_at(&toks, 5), "it is"));
+    assert(toks.types[7] == DOUBLE_QUOTED_VALUE);
+    assert(lexeme_is(sql, token_at(&toks, 7), "x"));
+    assert(toks.types[9] == NUMBER);
+    assert(lexeme_is(sql, token_at(&toks, 9), "42"));
+
+    /* Only the token arrays live in the arena */
+    assert(arena.used == (size_t)toks.cap * TOKEN_STACK_BYTES);
+
+    arena_free(&arena);
+}
+
+/**
+ * test_lookup_keyword_finds_every_keyword - Every generated keyword is found
+ * in any letter case, near misses are rejected
+ */
+static void test_lookup_keyword_finds_every_keyword(void)
+{
+    for (int i = 0; i < keyword_count; i++)
+    {
+        const char* kw = keywords[i].value;
+        size_t len     = strlen(kw);
+        char upper[KEYWORD_MAX_LEN];
+        char mixed[KEYWORD_MAX_LEN];
+        for (size_t j = 0; j < len; j++)
+        {
+            upper[j] = (char)toupper(kw[j]);
+            mixed[j] = j % 2 ? upper[j] : kw[j];
+        }
+
+        SqlSymbols type = END;
+        assert(lookup_keyword(kw, len, &type) && type == keywords[i].type);
+        type = END;
+        assert(lookup_keyword(upper, len, &type) && type == keywords[i].type);
+        type = END;
+        assert(lookup_keyword(mixed, len, &type) && type == keywords[i].type);
+
+        /* Prefixes of a keyword are identifiers */
+        assert(!lookup_keyword(kw, len - 1, &type) || len == 1);
+    }
+
+    const char* misses[] = {"selec", "selects", "sel_ct", "SELECT_", "o", "x",
+                            "fro@", "wherewherewhere1", "a_very_long_identifier"};
+    for (size_t i = 0; i < sizeof(misses) / sizeof(misses[0]); i++)
+    {
+        SqlSymbols type = END;
+        assert(!lookup_keyword(misses[i], strlen(misses[i]), &type));
+        assert(type == END);
+    }
+}
+
+/**
+ * test_quoted_keywords_stay_values - Keyword spellings inside quotes are not
+ * turned into keyword tokens
+ */
+static void test_quoted_keywords_stay_values(void)
+{
+    const char* sql = "SELECT a FROM t WHERE x = 'from';";
+    size_t sql_len  = strlen(sql);
+    Arena arena     = arena_init(arena_capacity_for(sql_len));
+    TokenStack toks = get_tokens(sql, sql_len, &arena);
+
+    assert(toks.len == 9);
+    assert(toks.types[7] == SINGLE_QUOTED_VALUE);
+    assert(validate_query(&toks));
+
+    arena_free(&arena);
+}
+
+/**
+ * test_tokenizes_empty_and_unterminated_quotes - An empty quoted value is a
+ * zero-length token, an unterminated one runs to the end of the input
+ */
+static void test_tokenizes_empty_and_unterminated_quotes(void)
+{
+    const char* sql = "UPDATE t SET a = '' WHERE b = \"open";
+    size_t sql_len  = strlen(sql);
+    Arena arena     = arena_init(arena_capacity_for(sql_len));
+    TokenStack toks = get_tokens(sql, sql_len, &arena);
+
+    assert(toks.len == 10);
+    assert(toks.types[5] == SINGLE_QUOTED_VALUE);
+    assert(token_at(&toks, 5).len == 0);
+    assert(toks.types[6] == WHERE);
+    assert(toks.types[9] == DOUBLE_QUOTED_VALUE);
+    assert(lexeme_is(sql, token_at(&toks, 9), "open"));
+
+    arena_free(&arena);
+}
+
+/**
+ * test_scan_kernels_match_scalar - Every SIMD kernel returns the same
+ * positions as the scalar kernel for all start offsets
+ */
+static void test_scan_kernels_match_scalar(void)
+{
+    /* Runs longer than a vector, breaks at every lane position and a tail
+     * shorter than a vector */
+    static const char alphabet[] = "abcXYZ_09*.'\" \t\n\r,;=()";
+    unsigned char buf[301];
+    unsigned seed = 12345;
+    for (size_t i = 0; i < sizeof(buf); i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        /* Mostly long runs of one kind, occasionally any byte */
+        unsigned r = (seed >> 16) % 100;
+        if (r < 45)
+            buf[i] = 'a';
+        else if (r < 80)
+            buf[i] = ' ';
+        else
+            buf[i] = (unsigned char)
+                alphabet[(seed >> 8) % (sizeof(alphabet) - 1)];
+    }
+
+    const ScanKernels* sets[3];
+    int n = available_scan_kernels(sets);
+    for (int k = 1; k < n; k++)
+    {
+        for (size_t len = 0; len <= sizeof(buf); len += 37)
+        {
+            for (size_t i = 0; i <= len; i++)
+            {
+                assert(sets[k]->skip_space(buf, i, len) ==
+                       scan_scalar.skip_space(buf, i, len));
+                assert(sets[k]->skip_run(buf, i, len) ==
+                       scan_scalar.skip_run(buf, i, len));
+                assert(sets[k]->find_quote(buf, i, len, '\'') ==
+                       scan_scalar.find_quote(buf, i, len, '\''));
+                assert(sets[k]->find_quote(buf, i, len, '"') ==
+                       scan_scalar.find_quote(buf, i, len, '"'));
+            }
+        }
+    }
+}
+
+/**
+ * test_tokenizer_kernels_agree - get_tokens yields identical tokens with every
+ * kernel set
+ */
+static void test_tokenizer_kernels_agree(void)
+{
+    const char* sql =
+        "INSERT INTO    logs VALUES (1, 'a quoted value that is longer than "
+        "thirty-two bytes', \"another quoted value, also rather long\", "
+        "averyveryveryverylongidentifier_with_digits_0123456789, 42);   ";
+    size_t sql_len = strlen(sql);
+
+    const ScanKernels* sets[3];
+    int n                    = available_scan_kernels(sets);
+    const ScanKernels* saved = scan;
+
+    scan            = &scan_scalar;
+    Arena ref_arena = arena_init(arena_capacity_for(sql_len));
+    TokenStack ref  = get_tokens(sql, sql_len, &ref_arena);
+    assert(ref.len == 16);
+
+    for (int k = 1; k < n; k++)
+    {
+        scan            = sets[k];
+        Arena arena     = arena_init(arena_capacity_for(sql_len));
+        TokenStack toks = get_tokens(sql, sql_len, &arena);
+
+        assert(toks.len == ref.len);
+        for (size_t i = 0; i < ref.len; i++)
+        {
+            assert(toks.types[i] == ref.types[i]);
+            assert(toks.offsets[i] == ref.offsets[i]);
+            assert(toks.ends[i] == ref.ends[i]);
+        }
+        arena_free(&arena);
+    }
+
+    scan = saved;
+    arena_free(&ref_arena);
+}
+
+/**
+ * test_check_query_matches_validator - The fused single-pass check accepts
+ * and rejects exactly what the two-pass pipeline does
+ */
+static void test_check_query_matches_validator(void)
+{
+    const char* queries[] = {
+        "",
+        "   ",
+        "SELECT a FROM t;",
+        "SELECT a, b FROM t WHERE id = 1 AND name = 'x'",
+        "INSERT INTO t VALUES ('a', \"b\", 3);",
+        "UPDATE t SET a = 1 WHERE b = 2;",
+        "DELETE FROM t WHERE a = 'x' OR b = 'y';",
+        "CREATE TABLE t (id INT, name TEXT);",
+        "SELECT a FROM t;;",
+        "SELECT FROM t;",
+        "SELECT a FROM",
+        "FROM users WHERE id = 1;",
+        "CREATE TABLE t (id, name TEXT);",
+        "INSERT INTO t VALUES (1",
+        "SELECT a FROM t; DROP",
+    };
+
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++)
+    {
+        const char* sql = queries[i];
+        Arena arena = arena_init(arena_capacity_for(strlen(sql)));
+        TokenStack toks = get_tokens(sql, strlen(sql), &arena);
+
+        assert(check_query(sql, strlen(sql)) == validate_query(&toks));
+
+        arena_free(&arena);
+    }
+}
+
+/**
+ * test_tokenizer_integrates_with_validator - Tokenizer output is accepted by
+ * validator
+ */
+static void test_tokenizer_integrates_with_validator(void)
+{
+    const char* sql = "SELECT a FROM t;";
+    size_t sql_len  = strlen(sql);
+    Arena arena     = arena_init(arena_capacity_for(sql_len));
+    TokenStack toks = get_tokens(sql, sql_len, &arena);
+
+    ValidationError errs[8];
+    ValidationResult res = {.errors = errs, .error_capacity = 8};
+    bool ok              = validate_query_with_errors(&toks, &res);
+
+    assert(ok);
+
+    arena_free(&arena);
+}
+
+/**
+ * test_next_statement_splits_at_semicolons - Statements are split after each
+ * semicolon, semicolons inside quotes are ignored
+ */
+static void test_next_statement_splits_at_semicolons(void)
+{
+    const char* buf = "SELECT a FROM t;\n"
+                      "INSERT INTO t VALUES ('x;y', \"a;b\");\n"
+                      "DELETE FROM t WHERE id = 1";
+    size_t len      = strlen(buf);
+    size_t cursor   = 0;
+    StatementRange stmt;
+
+    assert(next_statement(buf, len, &cursor, &stmt));
+    assert(stmt.start == 0);
+    assert(strncmp(buf + stmt.start, "SELECT a FROM t;", stmt.len) == 0);
+
+    assert(next_statement(buf, len, &cursor, &stmt));
+    assert(strncmp(buf + stmt.start,
+                   "INSERT INTO t VALUES ('x;y', \"a;b\");",
+                   stmt.len) == 0);
+
+    assert(next_statement(buf, len, &cursor, &stmt));
+    assert(strncmp(buf + stmt.start, "DELETE FROM t WHERE id = 1", stmt.len) ==
+           0);
+    assert(stmt.start + stmt.len == len);
+
+    assert(!next_statement(buf, len, &cursor, &stmt));
+}
+
+/**
+ * test_next_statement_skips_comments_and_blanks - Comment lines and trailing
+ * whitespace do not produce statements
+ */
+static void test_next_statement_skips_comments_and_blanks(void)
+{
+    const char* buf = "-- header\n\n  SELECT a FROM t;\n-- trailer\n  \n\f\v";
+    size_t len      = strlen(buf);
+    size_t cursor   = 0;
+    StatementRange stmt;
+
+    assert(next_statement(buf, len, &cursor, &stmt));
+    assert(strncmp(buf + stmt.start, "SELECT a FROM t;", stmt.len) == 0);
+    assert(stmt.len == strlen("SELECT a FROM t;"));
+
+    assert(!next_statement(buf, len, &cursor, &stmt));
+    assert(cursor == len);
+}
+
+/* Collects the verdicts of a stream validator for the tests below. */
+typedef struct
+{
+    StreamResult results[16];
+    size_t count;
+} StreamLog;
+
+static void stream_log_result(const StreamResult* result, void* user)
+{
+    StreamLog* log = user;
+    assert(log->count < sizeof(log->results) / sizeof(log->results[0]));
+    log->results[log->count++] = *result;
+}
+
+static StreamLog stream_in_chunks(const char* buf, size_t chunk)
+{
+    size_t len    = strlen(buf);
+    StreamLog log = {.count = 0};
+    StreamValidator sv;
+
+    stream_init(&sv, stream_log_result, &log);
+    for (size_t i = 0; i < len; i += chunk)
+        stream_feed(&sv, buf + i, len - i < chunk ? len - i : chunk);
+    stream_finish(&sv);
+    return log;
+}
+
+/**
+ * test_stream_matches_batch_split - Stream verdicts agree with check_query()
+ * on the statements next_statement() splits out
+ */
+static void test_stream_matches_batch_split(void)
+{
+    const char* buf = "-- header\n"
+                      "SELECT a FROM t;\n"
+                      "INSERT INTO t VALUES ('x;y', \"a;b\");\n"
+                      "SELECT FROM t;\n"
+                      "  -- between\n"
+                      "CREATE TABLE t (id INT, name TEXT);\n"
+                      "UPDATE t SET a = 1 WHERE";
+    size_t len      = strlen(buf);
+    StreamLog log   = stream_in_chunks(buf, len);
+
+    size_t cursor = 0;
+    size_t n      = 0;
+    StatementRange stmt;
+    while (next_statement(buf, len, &cursor, &stmt))
+    {
+        char sql[128];
+        assert(stmt.len < sizeof(sql));
+        memcpy(sql, buf + stmt.start, stmt.len);
+        sql[stmt.len] = '\0';
+
+        assert(n < log.count);
+        assert(log.results[n].index == n + 1);
+        assert(log.results[n].start == stmt.start);
+        assert(log.results[n].end == stmt.start + stmt.len);
+        assert(log.results[n].ok == check_query(sql, strlen(sql)));
+        n++;
+    }
+    assert(n == log.count);
+
+    assert(!log.results[2].ok);
+    assert(log.results[2].error_type == FROM);
+    const char* from = strstr(buf, "SELECT FROM") + strlen("SELECT ");
+    assert(log.results[2].error_offset == (size_t)(from - buf));
+    assert(!log.results[4].ok);
+    assert(log.results[4].error_type == END);
+    assert(log.results[4].error_offset == len);
+}
+
+/**
+ * test_stream_chunk_size_is_invisible - Splitting the input at any byte
+ * (inside keywords, identifiers, quotes and comments) gives the same verdicts
+ */
+static void test_stream_chunk_size_is_invisible(void)
+{
+    const char* buf = "-- c;\nSELECT very_long_column_name_here FROM t "
+                      "WHERE x = 'it;s' AND y = 12345;\n"
+                      "INSERT INTO t VALUES (\"q\", '');"
+                      "SELECT a FROM t;;"
+                      "DELETE FROM t WHERE a = 'open";
+    size_t len      = strlen(buf);
+    StreamLog whole = stream_in_chunks(buf, len);
+
+    assert(whole.count == 5);
+    assert(whole.results[0].ok && whole.results[1].ok && whole.results[2].ok);
+    assert(!whole.results[3].ok); // lone ';'
+    assert(whole.results[4].ok);  // the open quote runs to the end
+
+    for (size_t chunk = 1; chunk < len; chunk++)
+    {
+        StreamLog log = stream_in_chunks(buf, chunk);
+        assert(log.count == whole.count);
+        for (size_t i = 0; i < log.count; i++)
+        {
+            const StreamResult* a = &log.results[i];
+            const StreamResult* b = &whole.results[i];
+            assert(a->index == b->index && a->ok == b->ok);
+            assert(a->start == b->start && a->end == b->end);
+            assert(a->error_offset == b->error_offset);
+            assert(a->error_type == b->error_type);
+            assert(a->expected.mask == b->expected.mask);
+        }
+    }
+}
+
+/**
+ * test_public_validate_uses_explicit_length - scanql_validate() reads only
+ * @len bytes and reports an early end at offset @len
+ */
+static void test_public_validate_uses_explicit_length(void)
+{
+    /* The slice stops before "FROM t", so it is missing its table */
+    const char* buf = "SELECT a FROM t; garbage";
+    scanql_result r = {.error_limit = 1};
+
+    assert(scanql_validate(buf, strlen("SELECT a FROM t;"), &r));
+    assert(r.ok && r.error_count == 0);
+    assert(scanql_check(buf, strlen("SELECT a FROM t;")));
+
+    size_t len = strlen("SELECT a FROM");
+    assert(!scanql_validate(buf, len, &r));
+    assert(!r.ok && r.error_count == 1 && r.error_limit == 1);
+    assert(r.error.type == SCANQL_TOKEN_END);
+    assert(r.error.offset == len);
+    assert(r.error_index == 3);
+    assert(r.expected == (1u << SCANQL_TOKEN_IDENTIFIER));
+    assert(!scanql_check(buf, len));
+
+    /* Recovery skips to the ';', the x is a second error */
+    r.error_limit = 0;
+    assert(!scanql_validate("SELECT FROM WHERE; x", 20, &r));
+    assert(r.error.type == SCANQL_TOKEN_FROM && r.error.offset == 7);
+    assert(r.error.length == 4 && r.error_index == 1);
+    assert(r.error_count > 1);
+
+    assert(scanql_validate(NULL, 0, &r));
+}
+
+/**
+ * test_public_tokenize_counts_past_capacity - scanql_tokenize() fills at
+ * most @capacity tokens but always returns the full count
+ */
+static void test_public_tokenize_counts_past_capacity(void)
+{
+    const char* buf = "SELECT a, 'b' FROM t;";
+    size_t len      = strlen(buf);
+    scanql_token toks[8];
+
+    assert(scanql_tokenize(buf, len, NULL, 0) == 7);
+    assert(scanql_tokenize(buf, len, toks, 2) == 7);
+    assert(toks[0].type == SCANQL_TOKEN_SELECT);
+    assert(toks[1].type == SCANQL_TOKEN_IDENTIFIER);
+    assert(toks[1].offset == 7 && toks[1].length == 1);
+
+    assert(scanql_tokenize(buf, len, toks, 8) == 7);
+    assert(toks[3].type == SCANQL_TOKEN_SINGLE_QUOTED_VALUE);
+    assert(toks[3].offset == 11 && toks[3].length == 1);
+    assert(toks[6].type == SCANQL_TOKEN_SEMICOLON);
+}
+
+/**
+ * test_public_token_names_match - The public names are the internal ones
+ */
+static void test_public_token_names_match(void)
+{
+    for (int i = 0; i <= SCANQL_TOKEN_END; i++)
+        assert(strcmp(scanql_token_name((scanql_token_type)i),
+                      symbol_to_str[i]) == 0);
+    assert(strcmp(scanql_token_name((scanql_token_type)-1), "?") == 0);
+    assert(strcmp(scanql_version(), SCANQL_VERSION) == 0);
+
+    char expected[64];
+    scanql_expected_str((1u << SCANQL_TOKEN_FROM) | (1u << SCANQL_TOKEN_COMMA),
+                        expected,
+                        sizeof(expected));
+    assert(strcmp(expected, "FROM | COMMA") == 0);
+}
+
+/**
+ * test_public_format_result_draws_caret - The buffered report matches the
+ * printed one, underlines the offending token and reports its full length
+ */
+static void test_public_format_result_draws_caret(void)
+{
+    const char* sql = "SELECT FROM t;";
+    scanql_result r = {.error_limit = 1};
+    assert(!scanql_validate(sql, strlen(sql), &r));
+
+    char text[256];
+    size_t n = scanql_format_result(
+        text, sizeof(text), sql, strlen(sql), &r, SCANQL_PRINT_COLOR);
+    assert(n == strlen(text));
+    const char* caret =
+        "\n  SELECT FROM t;\n         " CLR_RED "^^^^" CLR_RESET;
+    assert(strstr(text, caret) != NULL);
+
+    char* printed = NULL;
+    size_t printed_len;
+    FILE* out = open_memstream(&printed, &printed_len);
+    assert(out != NULL);
+    scanql_fprint_result(out, sql, strlen(sql), &r, SCANQL_PRINT_COLOR);
+    fclose(out);
+    assert(printed_len == n && memcmp(printed, text, n) == 0);
+    free(printed);
+
+    char cut[8];
+    assert(scanql_format_result(cut, sizeof(cut), sql, strlen(sql), &r, 0) ==
+           scanql_format_result(NULL, 0, sql, strlen(sql), &r, 0));
+    assert(strcmp(cut, "validat") == 0);
+}
+
+/**
+ * test_public_lines_locate_offsets - Offsets map to 1-based lines and byte
+ * columns, including line ends and the end of the input
+ */
+static void test_public_lines_locate_offsets(void)
+{
+    const char* text    = "ab\n\ncde\nf";
+    scanql_lines* lines = scanql_lines_new(text, strlen(text));
+    assert(lines != NULL);
+
+    const struct
+    {
+        size_t offset;
+        size_t line;
+        size_t column;
+    } cases[] = {
+        {0, 1, 1}, {2, 1, 3}, {3, 2, 1}, {4, 3, 1},
+        {6, 3, 3}, {8, 4, 1}, {9, 4, 2}, {99, 4, 2},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        scanql_position pos;
+        assert(scanql_lines_locate(lines, cases[i].offset, &pos));
+        assert(pos.line == cases[i].line && pos.column == cases[i].column);
+    }
+    scanql_lines_free(lines);
+
+    scanql_position pos;
+    lines = scanql_lines_new(NULL, 0);
+    assert(scanql_lines_locate(lines, 0, &pos));
+    assert(pos.line == 1 && pos.column == 1);
+    scanql_lines_free(lines);
+    scanql_lines_free(NULL);
+}
+
+/**
+ * test_public_format_result_in_shows_one_line - Only a window of the
+ * offending input line is shown, located by input line and column
+ */
+static void test_public_format_result_in_shows_one_line(void)
+{
+    char input[512] = "SELECT a FROM t;\nSELECT a\nFROM t WHERE";
+    for (int i = 0; i < 20; i++)
+        strcat(input, " a = 1 AND");
+    strcat(input, " FROM;");
+    scanql_lines* lines = scanql_lines_new(input, strlen(input));
+
+    size_t cursor = 0;
+    scanql_span stmt;
+    assert(scanql_next_statement(input, strlen(input), &cursor, &stmt));
+    assert(scanql_next_statement(input, strlen(input), &cursor, &stmt));
+
+    scanql_result r = {.error_limit = 1};
+    assert(!scanql_validate(input + stmt.offset, stmt.length, &r));
+
+    char text[512];
+    size_t n = scanql_format_result_in(text, sizeof(text), lines, stmt, &r, 0);
+    assert(n == strlen(text));
+    assert(strstr(text, "--> line 3, column 214\n  ...") != NULL);
+    assert(strstr(text, "SELECT") == NULL); // other lines stay hidden
+    assert(strstr(text, "= 1 AND FROM;\n") != NULL);
+
+    /* The caret sits under the F of the last FROM */
+    const char* source = strstr(text, "  ...");
+    const char* nl     = strchr(source, '\n');
+    assert(strchr(nl, '^') - (nl + 1) == strstr(source, "FROM;") - source);
+    scanql_lines_free(lines);
+}
+
+/**
+ * test_public_suggest_keyword - A misspelled expected keyword is suggested,
+ * other failures get no suggestion
+ */
+static void test_public_suggest_keyword(void)
+{
+    const struct
+    {
+        const char* sql;
+        scanql_token_type want;
+    } cases[] = {
+        {"SELEC a FROM t;", SCANQL_TOKEN_SELECT},
+        {"SELECT a FORM t;", SCANQL_TOKEN_FROM},
+        {"SELECT a fro t;", SCANQL_TOKEN_FROM},
+        {"updtae t SET a = 1;", SCANQL_TOKEN_UPDATE},
+        {"SELECT a FROM t WHERE x = 1 ADN y = 2;", SCANQL_TOKEN_AND},
+        {"SELECT a FROM t WHER x = 1;", SCANQL_TOKEN_WHERE},
+        {"SELECT a FROM t WHERE x = 1 o y = 2;", SCANQL_TOKEN_END},
+        {"foo a;", SCANQL_TOKEN_END},
+        {"SELECT FROM t;", SCANQL_TOKEN_END},
+        {"SELECT a FROM t;", SCANQL_TOKEN_END},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        const char* sql = cases[i].sql;
+        scanql_result r = {.error_limit = 1};
+        scanql_validate(sql, strlen(sql), &r);
+        assert(scanql_suggest(sql, strlen(sql), &r) == cases[i].want);
+    }
+
+    /* "INTO" is a keyword, but not one expected after SELECT a */
+    const char* sql = "SELECT a INOT t;";
+    scanql_result r = {.error_limit = 1};
+    assert(!scanql_validate(sql, strlen(sql), &r));
+    assert(scanql_suggest(sql, strlen(sql), &r) == SCANQL_TOKEN_END);
+
+    /* The text report carries the suggestion */
+    sql = "SELECT a FORM t;";
+    scanql_validate(sql, strlen(sql), &r);
+    char text[512];
+    scanql_format_result(text, sizeof(text), sql, strlen(sql), &r, 0);
+    assert(strstr(text, "(unexpected token), did you mean FROM?") != NULL);
+}
+
+typedef struct
+{
+    size_t count;
+    scanql_statement stmts[8];
+} PublicStreamLog;
+
+static void public_stream_log(const scanql_statement* stmt, void* user)
+{
+    PublicStreamLog* log = user;
+    assert(log->count < 8);
+    log->stmts[log->count++] = *stmt;
+}
+
+/**
+ * test_public_stream_reports_statements - scanql_stream agrees with
+ * scanql_validate() on every statement of a byte-by-byte fed stream
+ */
+static void test_public_stream_reports_statements(void)
+{
+    const char* buf     = "SELECT a FROM t;\nSELECT FROM t;\nDELETE FROM";
+    size_t len          = strlen(buf);
+    PublicStreamLog log = {.count = 0};
+
+    scanql_stream* stream = scanql_stream_new(public_stream_log, &log);
+    assert(stream != NULL);
+    for (size_t i = 0; i < len; i++)
+        scanql_stream_feed(stream, buf + i, 1);
+    scanql_stream_finish(stream);
+    scanql_stream_free(stream);
+    scanql_stream_free(NULL);
+
+    assert(log.count == 3);
+    for (size_t i = 0; i < log.count; i++)
+    {
+        const scanql_statement* st = &log.stmts[i];
+        scanql_result r            = {.error_limit = 1};
+        scanql_validate(buf + st->span.offset, st->span.length, &r);
+
+        assert(st->index == i + 1);
+        assert(st->result.ok == r.ok);
+        if (r.ok)
+            continue;
+        assert(st->result.error.type == r.error.type);
+        assert(st->result.error.offset == st->span.offset + r.error.offset);
+        assert(st->result.error_index == r.error_index);
+        assert(st->result.expected == r.expected);
+    }
+    assert(!log.stmts[1].result.ok);
+    assert(log.stmts[2].result.error.type == SCANQL_TOKEN_END);
+    assert(log.stmts[2].result.error.offset == len);
+}
+
+/**
+ * test_cache_answers_repeated_shapes - Failing statements that only differ
+ * in literals and names share one entry, and a hit gives the same result as
+ * scanql_validate() on the statement itself
+ */
+static void test_cache_answers_repeated_shapes(void)
+{
+    scanql_cache* cache = scanql_cache_new(64);
+    assert(cache != NULL);
+
+    const char* sqls[] = {
+        "SELECT a FROM t WHERE id = 1;",
+        "SELECT bb FROM users WHERE name = 'x';",
+        "select c from u where k = \"y\";",
+        "SELECT a FROM WHERE id = 1;",
+        "SELECT longer_name FROM WHERE id = 'x';",
+        "UPDATE t SET a = 1 WHERE",
+        "UPDATE users SET name = 'z' WHERE",
+        "FROM t WHERE; SELECT",
+        "",
+    };
+    for (size_t limit = 0; limit <= 2; limit++)
+    {
+        for (size_t i = 0; i < sizeof(sqls) / sizeof(sqls[0]); i++)
+        {
+            size_t len      = strlen(sqls[i]);
+            scanql_result a = {.error_limit = limit};
+            scanql_result b = {.error_limit = limit};
+            bool ok         = scanql_validate_cached(cache, sqls[i], len, &a);
+            scanql_validate(sqls[i], len, &b);
+
+            assert(ok == b.ok && a.ok == b.ok);
+            assert(a.error_count == b.error_count);
+            assert(a.error_limit == limit);
+            if (b.ok)
+                continue;
+            assert(a.error.type == b.error.type);
+            assert(a.error.offset == b.error.offset);
+            assert(a.error.length == b.error.length);
+            assert(a.error_index == b.error_index);
+            assert(a.expected == b.expected);
+        }
+    }
+
+    scanql_cache_stats st;
+    scanql_cache_stats_get(cache, &st);
+    assert(st.capacity == 64);
+    /* Valid statements and limit 1 bypass the cache; limit 0 fills it */
+    assert(st.misses == 3 && st.entries == 3);
+    assert(st.hits == 7);
+    assert(st.evictions == 0);
+    scanql_cache_free(cache);
+    scanql_cache_free(NULL);
+}
+
+/**
+ * test_cache_stays_within_capacity - Distinct shapes evict old ones once
+ * the cache is full, and a NULL cache validates without one
+ */
+static void test_cache_stays_within_capacity(void)
+{
+    scanql_cache* cache = scanql_cache_new(10); // rounded down to 8
+    assert(cache != NULL);
+
+    char sql[512] = "SELECT a";
+    for (int i = 0; i < 100; i++)
+    {
+        strcat(sql, ", a");
+        char stmt[520];
+        snprintf(stmt, sizeof(stmt), "%s FROM", sql);
+
+        scanql_result r = {.error_limit = 0};
+        assert(!scanql_validate_cached(cache, stmt, strlen(stmt), &r));
+        assert(r.error.type == SCANQL_TOKEN_END);
+        assert(r.error.offset == strlen(stmt));
+    }
+
+    scanql_cache_stats st;
+    scanql_cache_stats_get(cache, &st);
+    assert(st.capacity == 8 && st.entries == 8);
+    assert(st.misses == 100 && st.hits == 0);
+    assert(st.evictions == 92);
+    scanql_cache_free(cache);
+
+    scanql_result r = {.error_limit = 0};
+    assert(scanql_validate_cached(NULL, "SELECT a FROM t;", 16, &r));
+    assert(!scanql_validate_cached(NULL, "SELECT FROM t;", 14, &r));
+}
+
+/* Normalize a NUL-terminated statement into a 256-byte buffer */
+static scanql_template normalize_str(const char* sql, char* out)
+{
+    scanql_template tpl;
+    scanql_normalize(sql, strlen(sql), out, 256, &tpl);
+    assert(tpl.length < 256 && strlen(out) == tpl.length);
+    return tpl;
+}
+
+/**
+ * test_normalize_replaces_literals - Literals become '?', keywords upper
+ * case and whitespace canonical
+ */
+static void test_normalize_replaces_literals(void)
+{
+    char out[256];
+
+    scanql_template tpl = normalize_str(
+        "select  a,b FROM t\n where id=42 and name = 'it''s';", out);
+    assert(strcmp(out, "SELECT a, b FROM t WHERE id = ? AND name = ? ?;") ==
+           0);
+    assert(tpl.tokens == 16);
+
+    normalize_str("insert into t values( 1 ,\"x\", '' )", out);
+    assert(strcmp(out, "INSERT INTO t VALUES (?, ?, ?)") == 0);
+
+    normalize_str("CREATE TABLE Users (Id INT, Name TEXT);", out);
+    assert(strcmp(out, "CREATE TABLE Users (Id INT, Name TEXT);") == 0);
+
+    tpl = normalize_str("", out);
+    assert(out[0] == '\0' && tpl.length == 0 && tpl.tokens == 0);
+}
+
+/**
+ * test_template_id_ignores_literals - The template ID follows the
+ * normalized text: literals, whitespace and keyword case do not change it,
+ * identifiers and structure do
+ */
+static void test_template_id_ignores_literals(void)
+{
+    char out[256];
+    uint64_t id = normalize_str("SELECT a FROM t WHERE id = 1;", out).id;
+
+    assert(normalize_str("select a\tfrom t where id='x' ;", out).id == id);
+    assert(normalize_str("SELECT a FROM t WHERE id = \"y\";", out).id == id);
+    assert(normalize_str("SELECT b FROM t WHERE id = 1;", out).id != id);
+    assert(normalize_str("SELECT a FROM t WHERE ab = 1;", out).id != id);
+    assert(normalize_str("SELECT a FROM t WHERE id = 1", out).id != id);
+    assert(normalize_str("SELECT a FROM t WHERE id = a;", out).id != id);
+
+    /* Control bytes in names must not pass for the class of a later token */
+    const char* pairs[][2] = {
+        {"x\x0e y=", "x=y\x0e"},
+        {"x\x16 y(", "x(y\x16"},
+        {"x\x17 y)", "x) y\x17"},
+    };
+    for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++)
+    {
+        char other[256];
+        scanql_template a = normalize_str(pairs[i][0], out);
+        scanql_template b = normalize_str(pairs[i][1], other);
+        assert(strcmp(out, other) != 0);
+        assert(a.id != b.id);
+    }
+}
+
+/**
+ * test_normalize_truncates_output - A short buffer keeps a NUL-terminated
+ * prefix and the full length is still reported
+ */
+static void test_normalize_truncates_output(void)
+{
+    const char* sql = "SELECT a FROM t;";
+    char out[8];
+    scanql_template full;
+    scanql_template cut;
+
+    scanql_normalize(sql, strlen(sql), NULL, 0, &full);
+    assert(full.length == strlen("SELECT a FROM t;"));
+
+    memset(out, 'x', sizeof(out));
+    scanql_normalize(sql, strlen(sql), out, sizeof(out), &cut);
+    assert(strcmp(out, "SELECT ") == 0);
+    assert(cut.length == full.length && cut.id == full.id);
+
+    scanql_normalize(sql, strlen(sql), out, 1, &cut);
+    assert(out[0] == '\0');
+}
+
+/**
+ * test_profile_matches_validate - A profiled run reaches the same verdicts
+ * as scanql_validate() and counts what it lexed
+ */
+static void test_profile_matches_validate(void)
+{
+    scanql_profile* profile = scanql_profile_new();
+    assert(profile != NULL);
+
+    const char* sqls[] = {
+        "SELECT a FROM t;",
+        "SELECT FROM t;",
+        "SELECT a, FROM WHERE",
+        "",
+        "INSERT INTO t VALUES (1, 'x');",
+    };
+    size_t count    = sizeof(sqls) / sizeof(sqls[0]);
+    uint64_t tokens = 0;
+    uint64_t bytes  = 0;
+    uint64_t errors = 0;
+    for (size_t limit = 0; limit <= 1; limit++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t len      = strlen(sqls[i]);
+            scanql_result a = {.error_limit = limit};
+            scanql_result b = {.error_limit = limit};
+            bool ok = scanql_validate_profiled(profile, sqls[i], len, &a);
+            scanql_validate(sqls[i], len, &b);
+
+            assert(ok == b.ok && a.ok == b.ok);
+            assert(a.error_count == b.error_count);
+            tokens += scanql_tokenize(sqls[i], len, NULL, 0);
+            bytes += len;
+            errors += b.error_count;
+            if (b.ok)
+                continue;
+            assert(a.error.type == b.error.type);
+            assert(a.error.offset == b.error.offset);
+            assert(a.error_index == b.error_index);
+            assert(a.expected == b.expected);
+        }
+    }
+
+    scanql_stats st;
+    scanql_profile_stats(profile, &st);
+    assert(st.statements == 2 * count && st.failed == 4);
+    assert(st.tokens == tokens && st.bytes == bytes);
+    assert(st.tokens_by_type[SCANQL_TOKEN_SELECT] == 6);
+    assert(st.tokens_by_type[SCANQL_TOKEN_COMMA] == 4);
+    assert(st.errors_recorded == errors && st.errors_stored == errors);
+    assert(st.arena_used > 0 && st.arena_used <= st.arena_capacity);
+    scanql_profile_free(profile);
+    scanql_profile_free(NULL);
+}
+
+#define HUGE_CHUNK ((size_t)1 << 20)
+
+/*
+ * map_huge_input - Map @chunks MiB of spaces without committing them: one
+ * MiB of a temporary file is mapped over and over into a reserved range.
+ * The chunks listed in @writable are private copies the caller can write.
+ * Return: the mapping, or NULL where the address space is too small or the
+ * file cannot be written or mapped.
+ */
+static char* map_huge_input(size_t chunks,
+                            const size_t* writable,
+                            size_t n_writable)
+{
+    if (SIZE_MAX / HUGE_CHUNK < chunks)
+        return NULL;
+
+    FILE* fp = tmpfile();
+    if (!fp)
+        return NULL;
+    static char spaces[HUGE_CHUNK];
+    memset(spaces, ' ', sizeof(spaces));
+    /* A short file would SIGBUS when read through the mappings */
+    size_t written = fwrite(spaces, 1, sizeof(spaces), fp);
+    if (written != sizeof(spaces) || fflush(fp) != 0)
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    char* base = mmap(NULL,
+                      chunks * HUGE_CHUNK,
+                      PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                      -1,
+                      0);
+    if (base == MAP_FAILED)
+    {
+        fclose(fp);
+        return NULL;
+    }
+    for (size_t i = 0; i < chunks; i++)
+    {
+        int prot  = PROT_READ;
+        int flags = MAP_SHARED | MAP_FIXED;
+        for (size_t k = 0; k < n_writable; k++)
+        {
+            if (writable[k] == i)
+            {
+                prot  = PROT_READ | PROT_WRITE;
+                flags = MAP_PRIVATE | MAP_FIXED;
+            }
+        }
+        void* p = mmap(base + i * HUGE_CHUNK,
+                       HUGE_CHUNK,
+                       prot,
+                       flags,
+                       fileno(fp),
+                       0);
+        if (p == MAP_FAILED)
+        {
+            munmap(base, chunks * HUGE_CHUNK);
+            fclose(fp);
+            return NULL;
+        }
+    }
+    fclose(fp); // the mappings keep the file alive
+    return base;
+}
+
+/**
+ * test_offsets_beyond_4gib - Offsets, lengths and line columns stay exact
+ * past 4 GiB, including a literal that straddles the 4 GiB boundary
+ */
+static void test_offsets_beyond_4gib(void)
+{
+    const size_t chunks   = 4097;
+    const size_t len      = chunks * HUGE_CHUNK;
+    const size_t boundary = (size_t)1 << 32;
+    const size_t writable[] = {
+        0,
+        boundary / HUGE_CHUNK - 1,
+        boundary / HUGE_CHUNK,
+    };
+    char* sql = map_huge_input(chunks, writable, 3);
+    if (!sql)
+        return;
+
+    const char head[] = "FROM t WHERE x = 'ab";
+    const char tail[] = "cd' AND FROM;\n";
+    memcpy(sql, "SELECT a\n", 9);
+    memcpy(sql + boundary - (sizeof(head) - 1), head, sizeof(head) - 1);
+    memcpy(sql + boundary, tail, sizeof(tail) - 1);
+    const size_t literal = boundary - 2; // quotes excluded
+    const size_t error   = boundary + 8;
+
+    /* The token stack restores the upper halves of both columns */
+    Arena arena     = {0};
+    TokenStack toks = get_tokens(sql, len, &arena);
+    assert(toks.len == 11);
+    Token t = token_at(&toks, 7);
+    assert(t.type == SINGLE_QUOTED_VALUE);
+    assert(t.pos == literal && t.len == 4);
+    t = token_at(&toks, 9);
+    assert(t.type == FROM && t.pos == error && t.len == 4);
+    t = token_at(&toks, 10);
+    assert(t.type == SEMICOLON && t.pos == error + 4);
+    arena_free(&arena);
+
+    /* Whitespace aside, the same verdict as the compact statement */
+    const char compact[] = "SELECT a FROM t WHERE x = 'abcd' AND FROM;";
+    scanql_result c      = {.error_limit = 0};
+    assert(!scanql_validate(compact, sizeof(compact) - 1, &c));
+    scanql_result r = {.error_limit = 0};
+    assert(!scanql_validate(sql, len, &r));
+    assert(r.error_count == c.error_count && r.expected == c.expected);
+    assert(r.error.offset == error && r.error.length == 4);
+
+    scanql_profile* profile = scanql_profile_new();
+    scanql_result p         = {.error_limit = 0};
+    assert(!scanql_validate_profiled(profile, sql, len, &p));
+    assert(p.error.offset == error && p.error_index == r.error_index);
+    scanql_stats st;
+    scanql_profile_stats(profile, &st);
+    assert(st.bytes == len && st.tokens == toks.len);
+    scanql_profile_free(profile);
+
+    scanql_lines* lines = scanql_lines_new(sql, len);
+    scanql_position pos;
+    assert(scanql_lines_locate(lines, error, &pos));
+    assert(pos.line == 2 && pos.column == error - 9 + 1);
+    scanql_lines_free(lines);
+
+    munmap(sql, len);
+}
+
+/**
+ * main - Run all unit tests for SqlValidateReport
+ */
+int main(void)
+{
+    { // tokenizer
+        test_tokenizes_basic_select();
+        test_tokens_are_views_into_source();
+        test_lookup_keyword_finds_every_keyword();
+        test_quoted_keywords_stay_values();
+        test_tokenizes_empty_and_unterminated_quotes();
+        test_scan_kernels_match_scalar();
+        test_tokenizer_kernels_agree();
+        test_tokenizer_integrates_with_validator();
+        test_check_query_matches_validator();
+    }
+
+    { // token stack
+        test_append_increments_len_until_capacity();
+        test_append_does_not_overflow_capacity();
+        test_append_marks_failed_epoch_truncated();
+        test_token_stack_grows_in_arena();
+        test_append_null_stack_is_safe();
+    }
+
+    { // arena
+        test_arena_grows_by_linking_blocks();
+        test_arena_reset_reuses_blocks();
+        test_arena_huge_block();
+    }
+
+    { // sql validate
+        test_expected_to_str_renders_mask();
+        test_grammar_table_is_dense_and_aligned();
+        test_grammar_literals_are_interchangeable();
+        test_create_table_column_list();
+        test_valid_simple_select_star();
+        test_valid_where_and_or();
+        test_invalid_missing_from();
+        test_invalid_trailing_after_semicolon();
+        test_accumulates_multiple_errors();
+        test_error_limit_stops_early();
+        test_check_query_with_errors_matches_validator();
+        test_recovery_resyncs_at_statement_boundaries();
+        test_invalid_token_aborts_early();
+        test_invalid_new_keyword_token();
+    }
+
+    { // sql validate report
+        test_report_formats_errors();
+        test_report_formats_new_symbols();
+        test_edit_distance_matches_reference();
+    }
+
+    { // batch
+        test_next_statement_splits_at_semicolons();
+        test_next_statement_skips_comments_and_blanks();
+    }
+
+    { // stream
+        test_stream_matches_batch_split();
+        test_stream_chunk_size_is_invisible();
+    }
+
+    { // public api
+        test_public_validate_uses_explicit_length();
+        test_public_tokenize_counts_past_capacity();
+        test_public_token_names_match();
+        test_public_format_result_draws_caret();
+        test_public_lines_locate_offsets();
+        test_public_format_result_in_shows_one_line();
+        test_public_suggest_keyword();
+        test_public_stream_reports_statements();
+    }
+
+    { // verdict cache
+        test_cache_answers_repeated_shapes();
+        test_cache_stays_within_capacity();
+    }
+
+    { // profile
+        test_profile_matches_validate();
+    }
+
+    { // inputs beyond 4 GiB
+        test_offsets_beyond_4gib();
+    }
+
+    { // template
+        test_normalize_replaces_literals();
+        test_template_id_ignores_literals();
+        test_normalize_truncates_output();
+    }
+    return 0;
+}
+#elif defined(BENCH_MODE)
+
+/**
+ * bench_now - Monotonic clock in seconds
+ */
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/*
+ * Statement mixes the benchmark corpora are built from. The mixed corpus is
+ * dominated by short identifiers, numbers and quoted values; the dump corpus
+ * mimics INSERT ... VALUES dumps with long string literals.
+ */
+static const char* const bench_mixed[] = {
+    "SELECT name, age, email FROM users WHERE id = 42 AND status = "
+    "'active';\n",
+    "INSERT INTO logs VALUES (1024, 'service started on port 8080', "
+    "\"info\", 1700000000);\n",
+    "UPDATE accounts SET balance = 1500 WHERE owner = 'alice' OR owner = "
+    "'bob';\n",
+    "CREATE TABLE events (id INTEGER, kind TEXT, payload TEXT);\n",
+    "DELETE FROM sessions WHERE token = 'c0ffee' AND expired = 1;\n",
+    NULL,
+};
+
+static const char* const bench_dump[] = {
+    "INSERT INTO documents VALUES (918273, 'Lorem ipsum dolor sit amet, "
+    "consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore "
+    "et dolore magna aliqua.', \"application/json\", '{\"title\": \"Ut enim "
+    "ad minim veniam\", \"tags\": [\"quis\", \"nostrud\", \"exercitation\"]}', "
+    "1700000000);\n",
+    "INSERT INTO documents VALUES (918274, 'Duis aute irure dolor in "
+    "reprehenderit in voluptate velit esse cillum dolore eu fugiat nulla "
+    "pariatur. Excepteur sint occaecat cupidatat non proident.', "
+    "\"text/plain\", '', 1700000001);\n",
+    NULL,
+};
+
+/* Statements with errors early on, for the error path of the cache bench */
+static const char* const bench_invalid[] = {
+    "SELECT FROM users WHERE id = 42 AND status = 'active';\n",
+    "UPDATE accounts SET WHERE owner = 'alice' OR owner = 'bob';\n",
+    "INSERT logs VALUES (1024, 'service started', \"info\", 1700000000);\n",
+    NULL,
+};
+
+/* Statements that only go wrong at their end */
+static const char* const bench_invalid_late[] = {
+    "SELECT id, name, email FROM users WHERE id = 42 AND status = 'active' "
+    "AND;\n",
+    "UPDATE accounts SET balance = 1200, owner = 'alice' WHERE id = 7 OR "
+    "owner = 'bob' OR;\n",
+    "INSERT INTO logs VALUES (1024, 'service started', \"info\", 1700000000"
+    ") WHERE;\n",
+    NULL,
+};
+
+/**
+ * bench_corpus - Build a NUL-terminated SQL corpus of @size bytes
+ * @statements: NULL-terminated list of statements to repeat
+ * @size: corpus size in bytes
+ *
+ * Return: malloc'd corpus owned by the caller.
+ */
+static char* bench_corpus(const char* const* statements, size_t size)
+{
+    size_t count = 0;
+    while (statements[count])
+        count++;
+
+    char* buf   = malloc(size + 1);
+    size_t used = 0;
+    for (size_t i = 0; used < size; i++)
+    {
+        const char* stmt = statements[i % count];
+        size_t n         = strlen(stmt);
+        if (n > size - used)
+            n = size - used;
+        memcpy(buf + used, stmt, n);
+        used += n;
+    }
+    buf[size] = '\0';
+    return buf;
+}
+
+/**
+ * bench_tokenizer - Report get_tokens throughput for every kernel set
+ * @label: corpus name for the report
+ * @statements: statement mix the corpus is built from
+ * @size: corpus size in bytes
+ * @runs: number of timed runs per kernel set; the fastest one is reported
+ */
+static void bench_tokenizer(const char* label,
+                            const char* const* statements,
+                            size_t size,
+                            int runs)
+{
+    char* sql      = bench_corpus(statements, size);
+    size_t sql_len = strlen(sql);
+    Arena arena    = arena_init(arena_capacity_for(size));
+
+    const ScanKernels* sets[3];
+    int n                    = available_scan_kernels(sets);
+    const ScanKernels* saved = scan;
+
+    for (int k = 0; k < n; k++)
+    {
+        scan        = sets[k];
+        double best = 0.0;
+        int tokens  = 0;
+
+        for (int r = 0; r < runs; r++)
+        {
+            arena_reset(&arena);
+            double t0       = bench_now();
+            TokenStack toks = get_tokens(sql, sql_len, &arena);
+            double elapsed  = bench_now() - t0;
+
+            tokens = toks.len;
+            if (r == 0 || elapsed < best)
+                best = elapsed;
+        }
+
+        printf("get_tokens %-5s %-6s %6.1f MiB: %9d tokens %8.2f ms "
+               "%6.2f GB/s %6.2f ns/token\n",
+               label,
+               sets[k]->name,
+               (double)size / (1 << 20),
+               tokens,
+               best * 1e3,
+               (double)size / best / 1e9,
+               best * 1e9 / tokens);
+    }
+
+    scan = saved;
+    arena_free(&arena);
+    free(sql);
+}
+
+/**
+ * bench_normalize - Report scanql_normalize() throughput
+ * @label: corpus name for the report
+ * @statements: statement mix the corpus is built from
+ * @size: corpus size in bytes
+ * @runs: number of timed runs; the fastest one is reported
+ */
+static void bench_normalize(const char* label,
+                            const char* const* statements,
+                            size_t size,
+                            int runs)
+{
+    char* sql   = bench_corpus(statements, size);
+    size_t cap  = 2 * size + 1;
+    char* out   = malloc(cap);
+    double best = 0.0;
+    scanql_template tpl;
+
+    for (int r = 0; r < runs; r++)
+    {
+        double t0 = bench_now();
+        scanql_normalize(sql, size, out, cap, &tpl);
+        double elapsed = bench_now() - t0;
+        if (r == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    printf("normalize  %-5s        %6.1f MiB: %9zu tokens %8.2f ms "
+           "%6.2f GB/s %6.2f ns/token\n",
+           label,
+           (double)size / (1 << 20),
+           tpl.tokens,
+           best * 1e3,
+           (double)size / best / 1e9,
+           best * 1e9 / (double)tpl.tokens);
+
+    free(out);
+    free(sql);
+}
+
+/**
+ * bench_cache - Compare scanql_validate() with a warm verdict cache
+ * @label: corpus name for the report
+ * @statements: statement mix the corpus is built from
+ * @size: corpus size in bytes
+ * @error_limit: error limit of every validation, 0 to count all errors
+ *
+ * Plain and cached runs alternate, and the best of BENCH_CACHE_ROUNDS runs
+ * of each is reported, so that a noisy machine hits both alike.
+ */
+#define BENCH_CACHE_ROUNDS 7
+
+static void bench_cache(const char* label,
+                        const char* const* statements,
+                        size_t size,
+                        size_t error_limit)
+{
+    char* sql           = bench_corpus(statements, size);
+    size_t sql_len      = strlen(sql);
+    scanql_cache* cache = scanql_cache_new(1024);
+    double best[2]      = {0, 0};
+    size_t count        = 0;
+
+    /* Round 0 warms the cache and is not counted */
+    for (int round = 0; round <= BENCH_CACHE_ROUNDS; round++)
+    {
+        for (int cached = 0; cached < 2; cached++)
+        {
+            size_t cursor = 0;
+            scanql_span stmt;
+            count     = 0;
+            double t0 = bench_now();
+            while (scanql_next_statement(sql, sql_len, &cursor, &stmt))
+            {
+                scanql_result r = {.error_limit = error_limit};
+                if (cached)
+                    scanql_validate_cached(
+                        cache, sql + stmt.offset, stmt.length, &r);
+                else
+                    scanql_validate(sql + stmt.offset, stmt.length, &r);
+                count++;
+            }
+            double elapsed = bench_now() - t0;
+            if (round > 0 && (round == 1 || elapsed < best[cached]))
+                best[cached] = elapsed;
+        }
+    }
+
+    for (int cached = 0; cached < 2; cached++)
+        printf("validate %-12s limit %zu %-6s %9zu statements %8.2f ms "
+               "%6.1f ns/statement\n",
+               label,
+               error_limit,
+               cached ? "cached" : "plain",
+               count,
+               best[cached] * 1e3,
+               best[cached] * 1e9 / (double)count);
+
+    scanql_cache_free(cache);
+    free(sql);
+}
+
+/*
+ * Synthetic corpus for the phase benchmarks. A xorshift64* generator with a
+ * fixed seed makes the corpus a pure function of its size. Statements mix
+ * short SELECTs, wide INSERT ... VALUES, long WHERE chains of AND/OR and
+ * CREATE TABLE, and one in BENCH_BROKEN_EVERY lacks its table name so that
+ * the error path is exercised too.
+ */
+#define BENCH_SEED 0x5ca1ab1e5eedull
+#define BENCH_BROKEN_EVERY 20
+#define BENCH_BATCH_BYTES (64 * 1024)
+#define BENCH_MIN_WORK ((size_t)4 << 20)
+
+typedef struct
+{
+    uint64_t state;
+} BenchRng;
+
+static uint64_t bench_next(BenchRng* rng)
+{
+    uint64_t x = rng->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rng->state = x;
+    return x * 0x2545f4914f6cdd1dull;
+}
+
+static size_t bench_below(BenchRng* rng, size_t n)
+{
+    return (size_t)(bench_next(rng) % n);
+}
+
+/**
+ * struct BenchCorpus - Generated SQL and where its statements start
+ * @sql: statements separated by newlines, NUL-terminated
+ * @len: bytes in @sql
+ * @cap: size of the @sql allocation
+ * @starts: offset of every statement, plus @len as the last entry
+ * @count: number of statements
+ * @starts_cap: entries allocated in @starts
+ */
+typedef struct
+{
+    char* sql;
+    size_t len;
+    size_t cap;
+    size_t* starts;
+    size_t count;
+    size_t starts_cap;
+} BenchCorpus;
+
+static void bench_put(BenchCorpus* c, const char* s)
+{
+    size_t n = strlen(s);
+    if (c->len + n + 1 > c->cap)
+    {
+        c->cap = (c->len + n + 1) * 2;
+        c->sql = realloc(c->sql, c->cap);
+        assert(c->sql != NULL);
+    }
+    memcpy(c->sql + c->len, s, n + 1);
+    c->len += n;
+}
+
+static const char* const bench_columns[] = {
+    "id",     "name",       "email", "created_at",    "user_id",
+    "amount", "status",     "a",     "total_price",   "customer_name",
+    "kind",   "updated_at", "qty",   "shipping_addr",
+};
+
+static const char* const bench_tables[] = {
+    "users", "orders", "t", "events", "line_items", "audit_log_2024",
+};
+
+static const char* const bench_types[] = {"INT", "TEXT", "REAL", "BLOB"};
+
+#define BENCH_PICK(rng, list)                                                  \
+    (list)[bench_below((rng), sizeof(list) / sizeof((list)[0]))]
+
+static void bench_put_literal(BenchCorpus* c, BenchRng* rng)
+{
+    char buf[64];
+    size_t kind = bench_below(rng, 3);
+    if (kind == 0)
+    {
+        snprintf(buf, sizeof(buf), "%u", (unsigned)bench_below(rng, 1000000));
+        bench_put(c, buf);
+        return;
+    }
+
+    size_t n = bench_below(rng, 40);
+    buf[0]   = kind == 1 ? '\'' : '"';
+    for (size_t i = 0; i < n; i++)
+        buf[1 + i] = "abcdefghijklmnopqrstuvwxyz  .,;-"[bench_below(rng, 32)];
+    buf[1 + n] = buf[0];
+    buf[2 + n] = '\0';
+    bench_put(c, buf);
+}
+
+static void bench_put_table(BenchCorpus* c, BenchRng* rng, bool broken)
+{
+    if (!broken)
+        bench_put(c, BENCH_PICK(rng, bench_tables));
+}
+
+static void bench_put_condition(BenchCorpus* c, BenchRng* rng)
+{
+    bench_put(c, BENCH_PICK(rng, bench_columns));
+    bench_put(c, " = ");
+    bench_put_literal(c, rng);
+}
+
+/* Append one statement of a random kind, followed by a newline. */
+static void bench_put_statement(BenchCorpus* c, BenchRng* rng, bool broken)
+{
+    size_t kind = bench_below(rng, 20);
+
+    if (kind < 8) // short SELECT
+    {
+        bench_put(c, "SELECT ");
+        size_t cols = bench_below(rng, 4);
+        if (cols == 0)
+            bench_put(c, "*");
+        for (size_t i = 0; i < cols; i++)
+        {
+            bench_put(c, i ? ", " : "");
+            bench_put(c, BENCH_PICK(rng, bench_columns));
+        }
+        bench_put(c, " FROM ");
+        bench_put_table(c, rng, broken);
+        if (bench_below(rng, 2))
+        {
+            bench_put(c, " WHERE ");
+            bench_put_condition(c, rng);
+        }
+    }
+    else if (kind < 13) // wide INSERT ... VALUES
+    {
+        bench_put(c, "INSERT INTO ");
+        bench_put_table(c, rng, broken);
+        bench_put(c, " VALUES (");
+        size_t values = 8 + bench_below(rng, 25);
+        for (size_t i = 0; i < values; i++)
+        {
+            bench_put(c, i ? ", " : "");
+            bench_put_literal(c, rng);
+        }
+        bench_put(c, ")");
+    }
+    else if (kind < 17) // long WHERE chain
+    {
+        bench_put(c, "SELECT ");
+        bench_put(c, BENCH_PICK(rng, bench_columns));
+        bench_put(c, " FROM ");
+        bench_put_table(c, rng, broken);
+        bench_put(c, " WHERE ");
+        size_t terms = 16 + bench_below(rng, 49);
+        for (size_t i = 0; i < terms; i++)
+        {
+            if (i)
+                bench_put(c, bench_below(rng, 3) ? " AND " : " OR ");
+            bench_put_condition(c, rng);
+        }
+    }
+    else // CREATE TABLE
+    {
+        bench_put(c, "CREATE TABLE ");
+        bench_put_table(c, rng, broken);
+        bench_put(c, " (");
+        size_t cols = 4 + bench_below(rng, 13);
+        for (size_t i = 0; i < cols; i++)
+        {
+            bench_put(c, i ? ", " : "");
+            bench_put(c, BENCH_PICK(rng, bench_columns));
+            bench_put(c, " ");
+            bench_put(c, BENCH_PICK(rng, bench_types));
+        }
+        bench_put(c, ")");
+    }
+    bench_put(c, ";\n");
+}
+
+/**
+ * bench_generate - Build a deterministic corpus of about @size bytes
+ * @size: target size; the corpus ends after the statement reaching it
+ *
+ * Return: the corpus; release it with bench_corpus_free().
+ */
+static BenchCorpus bench_generate(size_t size)
+{
+    BenchCorpus c = {.cap = size + 4096};
+    c.sql         = malloc(c.cap);
+    assert(c.sql != NULL);
+    c.sql[0] = '\0';
+
+    BenchRng rng = {.state = BENCH_SEED};
+    while (c.len < size)
+    {
+        if (c.count + 2 > c.starts_cap)
+        {
+            c.starts_cap = c.starts_cap ? c.starts_cap * 2 : 1024;
+            c.starts     = realloc(c.starts, c.starts_cap * sizeof(size_t));
+            assert(c.starts != NULL);
+        }
+        c.starts[c.count++] = c.len;
+        bench_put_statement(
+            &c, &rng, bench_below(&rng, BENCH_BROKEN_EVERY) == 0);
+    }
+    c.starts[c.count] = c.len;
+    return c;
+}
+
+static void bench_corpus_free(BenchCorpus* c)
+{
+    free(c->starts);
+    free(c->sql);
+}
+
+/* Time and work of one benchmarked phase */
+typedef struct
+{
+    const char* name;
+    double seconds;
+    size_t items; // tokens, or keyword lookups
+} BenchPhase;
+
+static void bench_report(const char* size_label,
+                         const BenchPhase* phase,
+                         size_t bytes,
+                         size_t statements)
+{
+    printf("%-8s %-9s %9.2f ns/token %10.1f MB/s %12.0f stmts/s\n",
+           size_label,
+           phase->name,
+           phase->seconds * 1e9 / (double)(phase->items ? phase->items : 1),
+           (double)bytes / phase->seconds / 1e6,
+           (double)statements / phase->seconds);
+}
+
+/* Keeps the compiler from dropping work whose result is otherwise unused */
+static volatile size_t bench_sink;
+
+/**
+ * bench_phases - Time every stage of validating a generated corpus
+ * @size: corpus size in bytes
+ * @label: size label for the report
+ *
+ * The corpus is processed in batches of about BENCH_BATCH_BYTES. Each batch
+ * is lexed with get_tokens(), its words are looked up with
+ * lookup_keyword(), its token stacks are validated with
+ * validate_query_with_errors() and the results are printed to /dev/null with
+ * fprint_validation_result(); each stage is timed on its own. Small corpora
+ * are repeated until BENCH_MIN_WORK bytes have been processed.
+ */
+static void bench_phases(size_t size, const char* label)
+{
+    BenchCorpus c = bench_generate(size);
+    FILE* devnull = fopen("/dev/null", "w");
+    assert(devnull != NULL);
+
+    size_t reps = c.len < BENCH_MIN_WORK ? BENCH_MIN_WORK / c.len : 1;
+    size_t cap  = 1024;
+    TokenStack* stacks      = malloc(cap * sizeof(*stacks));
+    ValidationResult* valid = malloc(cap * sizeof(*valid));
+    assert(stacks && valid);
+
+    BenchPhase lex      = {.name = "tokenize"};
+    BenchPhase keywords = {.name = "keywords"};
+    BenchPhase validate = {.name = "validate"};
+    BenchPhase print    = {.name = "print"};
+    Arena arena         = {0};
+
+    for (size_t rep = 0; rep < reps; rep++)
+    {
+        for (size_t first = 0; first < c.count;)
+        {
+            size_t n = 0;
+            while (first + n < c.count &&
+                   c.starts[first + n] - c.starts[first] < BENCH_BATCH_BYTES)
+                n++;
+            if (n > cap)
+            {
+                cap    = n * 2;
+                stacks = realloc(stacks, cap * sizeof(*stacks));
+                valid  = realloc(valid, cap * sizeof(*valid));
+                assert(stacks && valid);
+            }
+            arena_reset(&arena);
+
+            double t0 = bench_now();
+            for (size_t i = 0; i < n; i++)
+            {
+                size_t at = c.starts[first + i];
+                stacks[i] = get_tokens(
+                    c.sql + at, c.starts[first + i + 1] - at, &arena);
+                lex.items += (size_t)stacks[i].len;
+            }
+
+            double t1    = bench_now();
+            size_t found = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                const char* sql = c.sql + c.starts[first + i];
+                for (size_t k = 0; k < stacks[i].len; k++)
+                {
+                    Token t = token_at(&stacks[i], k);
+                    if (t.type != SQL_IDENTIFIER && t.type > TABLE &&
+                        t.type != AND && t.type != OR)
+                        continue;
+                    SqlSymbols type;
+                    found += lookup_keyword(sql + t.pos, (size_t)t.len, &type);
+                    keywords.items++;
+                }
+            }
+            bench_sink += found;
+
+            /* Error storage is set up outside of the timed region */
+            double t2 = bench_now();
+            for (size_t i = 0; i < n; i++)
+            {
+                size_t at = c.starts[first + i];
+                valid[i]  = validation_result_init(
+                    &arena, 0, (size_t)stacks[i].len);
+                valid[i].sql     = c.sql + at;
+                valid[i].sql_len = c.starts[first + i + 1] - at - 1;
+            }
+
+            double t3 = bench_now();
+            for (size_t i = 0; i < n; i++)
+                bench_sink += validate_query_with_errors(&stacks[i], &valid[i]);
+
+            double t4 = bench_now();
+            for (size_t i = 0; i < n; i++)
+                fprint_validation_result(devnull, &valid[i], true);
+            double t5 = bench_now();
+
+            lex.seconds += t1 - t0;
+            keywords.seconds += t2 - t1;
+            validate.seconds += t4 - t3;
+            print.seconds += t5 - t4;
+            first += n;
+        }
+    }
+    validate.items = print.items = lex.items;
+
+    size_t bytes      = c.len * reps;
+    size_t statements = c.count * reps;
+    bench_report(label, &lex, bytes, statements);
+    bench_report(label, &keywords, bytes, statements);
+    bench_report(label, &validate, bytes, statements);
+    bench_report(label, &print, bytes, statements);
+
+    arena_free(&arena);
+    free(valid);
+    free(stacks);
+    fclose(devnull);
+    bench_corpus_free(&c);
+}
+
+/* Parse a byte count with an optional K, M or G suffix; 0 if invalid. */
+static size_t bench_parse_size(const char* s)
+{
+    char* end;
+    unsigned long long n = strtoull(s, &end, 10);
+    if (end == s)
+        return 0;
+    if (*end == 'K')
+        n <<= 10, end++;
+    else if (*end == 'M')
+        n <<= 20, end++;
+    else if (*end == 'G')
+        n <<= 30, end++;
+    return *end == '\0' ? (size_t)n : 0;
+}
+
+/**
+ * main - Run the benchmarks
+ *
+ * Usage: bench_scanql [phases|kernels|normalize|cache] [--max-size <n>[KMG]]
+ *
+ * Without a group name all groups run. The phase benchmark runs on
+ * generated corpora from 100 B up to --max-size, 16M by default and 1G at
+ * most.
+ */
+int main(int argc, char* argv[])
+{
+    const char* group = NULL;
+    size_t max_size   = (size_t)16 << 20;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc)
+            max_size = bench_parse_size(argv[++i]);
+        else if (!group && strncmp(argv[i], "--", 2) != 0)
+            group = argv[i];
+        else
+            max_size = 0;
+    }
+    bool known = !group || strcmp(group, "phases") == 0 ||
+                 strcmp(group, "kernels") == 0 ||
+                 strcmp(group, "normalize") == 0 || strcmp(group, "cache") == 0;
+    if (max_size == 0 || !known)
+    {
+        fprintf(stderr,
+                "usage: %s [phases|kernels|normalize|cache] "
+                "[--max-size <n>[KMG]]\n",
+                argv[0]);
+        return 2;
+    }
+
+    bool all = group == NULL;
+    if (all || strcmp(group, "phases") == 0)
+    {
+        static const struct
+        {
+            size_t size;
+            const char* label;
+        } sizes[] = {
+            {100, "100B"},
+            {(size_t)10 << 10, "10KiB"},
+            {(size_t)1 << 20, "1MiB"},
+            {(size_t)16 << 20, "16MiB"},
+            {(size_t)256 << 20, "256MiB"},
+            {(size_t)1 << 30, "1GiB"},
+        };
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+            if (sizes[i].size <= max_size)
+                bench_phases(sizes[i].size, sizes[i].label);
+    }
+    if (all || strcmp(group, "kernels") == 0)
+    {
+        bench_tokenizer("mixed", bench_mixed, (size_t)1 << 20, 10);
+        bench_tokenizer("mixed", bench_mixed, (size_t)16 << 20, 3);
+        bench_tokenizer("dump", bench_dump, (size_t)1 << 20, 10);
+        bench_tokenizer("dump", bench_dump, (size_t)16 << 20, 3);
+    }
+    if (all || strcmp(group, "normalize") == 0)
+    {
+        bench_normalize("mixed", bench_mixed, (size_t)16 << 20, 3);
+        bench_normalize("dump", bench_dump, (size_t)16 << 20, 3);
+    }
+    if (all || strcmp(group, "cache") == 0)
+    {
+        bench_cache("mixed", bench_mixed, (size_t)16 << 20, 1);
+        bench_cache("invalid", bench_invalid, (size_t)16 << 20, 1);
+        bench_cache("invalid", bench_invalid, (size_t)16 << 20, 0);
+        bench_cache("invalid-late", bench_invalid_late, (size_t)16 << 20, 0);
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,503 @@
+/*
+ * scanql.h - Public API of libscanql, the scanql SQL validator
+ *
+ * All functions take explicit-length buffers; no NUL terminator is needed
+ * and the input is never modified or retained. Offsets are byte offsets
+ * into the buffer passed to the call. Every function is reentrant and may
+ * be called from several threads at once, except that a scanql_stream must
+ * only be used by one thread at a time.
+ */
+#ifndef SCANQL_H
+#define SCANQL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(SCANQL_BUILD) && defined(__GNUC__)
+#define SCANQL_API __attribute__((visibility("default")))
+#else
+#define SCANQL_API
+#endif
+
+#define SCANQL_VERSION "0.1"
+
+/*
+ * scanql_token_type - Token types recognised by the validator. New types
+ * are only ever added before SCANQL_TOKEN_END.
+ */
+typedef enum scanql_token_type
+{
+    SCANQL_TOKEN_SELECT,
+    SCANQL_TOKEN_FROM,
+    SCANQL_TOKEN_WHERE,
+    SCANQL_TOKEN_UPDATE,
+    SCANQL_TOKEN_DELETE,
+    SCANQL_TOKEN_INSERT,
+    SCANQL_TOKEN_INTO,
+    SCANQL_TOKEN_VALUES,
+    SCANQL_TOKEN_SET,
+    SCANQL_TOKEN_JOIN,
+    SCANQL_TOKEN_CREATE,
+    SCANQL_TOKEN_TABLE,
+    SCANQL_TOKEN_COMMA,
+    SCANQL_TOKEN_SEMICOLON,
+    SCANQL_TOKEN_EQUALS,
+    SCANQL_TOKEN_STAR,
+    SCANQL_TOKEN_NUMBER,
+    SCANQL_TOKEN_DOUBLE_QUOTED_VALUE,
+    SCANQL_TOKEN_SINGLE_QUOTED_VALUE,
+    SCANQL_TOKEN_IDENTIFIER,
+    SCANQL_TOKEN_AND,
+    SCANQL_TOKEN_OR,
+    SCANQL_TOKEN_ROUND_BRACKETS_OPEN,
+    SCANQL_TOKEN_ROUND_BRACKETS_CLOSE,
+    SCANQL_TOKEN_END, // end of input
+} scanql_token_type;
+
+/**
+ * struct scanql_token - One token of the input
+ * @type: token type
+ * @offset: byte offset of the lexeme; quoted values exclude the quotes
+ * @length: lexeme length in bytes
+ */
+typedef struct scanql_token
+{
+    scanql_token_type type;
+    size_t offset;
+    size_t length;
+} scanql_token;
+
+/**
+ * struct scanql_result - Outcome of validating one statement
+ * @error_limit: in: stop after this many errors; 0 finds all, 1 returns at
+ *               the first error
+ * @ok: true if the statement is valid
+ * @error_count: errors found, at most @error_limit
+ * @error: token of the first error; type SCANQL_TOKEN_END with the offset
+ *         at the end of the input if the statement ended too early
+ * @error_index: index of @error in the token stream
+ * @expected: token types accepted instead of @error, one bit per
+ *            (1 << scanql_token_type)
+ *
+ * The error fields are only set when @ok is false.
+ */
+typedef struct scanql_result
+{
+    size_t error_limit;
+    bool ok;
+    size_t error_count;
+    scanql_token error;
+    size_t error_index;
+    uint64_t expected;
+} scanql_result;
+
+/**
+ * struct scanql_span - A statement inside a larger buffer
+ * @offset: byte offset of the first character
+ * @length: length in bytes, including the terminating ';' if any
+ */
+typedef struct scanql_span
+{
+    size_t offset;
+    size_t length;
+} scanql_span;
+
+/* Returns the library version, SCANQL_VERSION of the build. */
+SCANQL_API const char* scanql_version(void);
+
+/* Returns the name of a token type, e.g. "SELECT", or "?" if unknown. */
+SCANQL_API const char* scanql_token_name(scanql_token_type type);
+
+/**
+ * scanql_check - Validate a statement, answer only yes or no
+ * @buf: SQL text
+ * @len: bytes in @buf
+ *
+ * The fastest entry point: lexes and validates in one pass, stops at the
+ * first error and allocates nothing. Empty input is valid.
+ */
+SCANQL_API bool scanql_check(const char* buf, size_t len);
+
+/**
+ * scanql_validate - Validate a statement and describe its first error
+ * @buf: SQL text
+ * @len: bytes in @buf
+ * @result: in: @result->error_limit; out: the verdict
+ *
+ * Allocates nothing. A valid statement costs the same as scanql_check().
+ *
+ * Return: @result->ok.
+ */
+SCANQL_API bool
+scanql_validate(const char* buf, size_t len, scanql_result* result);
+
+/**
+ * scanql_suggest - Keyword a failed statement's first error may be a typo of
+ * @buf: SQL text @result was validated from
+ * @len: bytes in @buf
+ * @result: failed verdict
+ *
+ * Only a name where keywords were expected gets a suggestion: the expected
+ * keyword fewest edits away, with swapped neighbours counting as one edit,
+ * e.g. SELECT for "SELEC" and FROM for "FORM". Costs a few hundred
+ * nanoseconds; nothing is computed while validating.
+ *
+ * Return: the suggested keyword, or SCANQL_TOKEN_END if there is none.
+ */
+SCANQL_API scanql_token_type
+scanql_suggest(const char* buf, size_t len, const scanql_result* result);
+
+/*
+ * Verdict cache. Whether a statement is valid, and where its errors are in
+ * token terms, only depends on its sequence of token types, so statements of
+ * the same shape with other literals or names share one entry. Entries are
+ * keyed by a 64-bit fingerprint of that sequence and evicted with CLOCK once
+ * the cache is full. A cache may be shared by any number of threads.
+ *
+ * Validation is a single pass that stops at the first error, so the cache
+ * only pays off where a second pass would follow: failing statements whose
+ * errors are counted beyond the first (error_limit other than 1).
+ */
+typedef struct scanql_cache scanql_cache;
+
+/**
+ * struct scanql_cache_stats - Counters of a verdict cache
+ * @hits: lookups answered from the cache
+ * @misses: lookups that had to validate
+ * @evictions: entries replaced to make room
+ * @entries: entries in use
+ * @capacity: maximum number of entries
+ */
+typedef struct scanql_cache_stats
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+    size_t capacity;
+} scanql_cache_stats;
+
+/**
+ * scanql_cache_new - Create a verdict cache
+ * @capacity: maximum number of entries; rounded down to a power of two, at
+ *            least 8
+ *
+ * Return: the cache, or NULL if out of memory.
+ */
+SCANQL_API scanql_cache* scanql_cache_new(size_t capacity);
+
+/* Releases a cache; NULL is ignored. */
+SCANQL_API void scanql_cache_free(scanql_cache* cache);
+
+/**
+ * scanql_validate_cached - scanql_validate() through a verdict cache
+ * @cache: cache to consult and fill; NULL validates without one
+ * @buf: SQL text
+ * @len: bytes in @buf
+ * @result: in: @result->error_limit; out: the verdict
+ *
+ * A single lexing pass validates up to the first error and fingerprints the
+ * statement. Valid statements are done after it, and a failing one whose
+ * shape is cached gets its error count from the cache instead of a second
+ * pass with error recovery. That saves the most for statements that go
+ * wrong late; a miss costs the same two passes as scanql_validate(). An
+ * error limit of 1 skips the cache. The result is the same as that of
+ * scanql_validate().
+ *
+ * Return: @result->ok.
+ */
+SCANQL_API bool scanql_validate_cached(scanql_cache* cache,
+                                       const char* buf,
+                                       size_t len,
+                                       scanql_result* result);
+
+/* Copies the current counters of @cache into @stats. */
+SCANQL_API void scanql_cache_stats_get(const scanql_cache* cache,
+                                       scanql_cache_stats* stats);
+
+/*
+ * Validation profiles. A profile validates like scanql_validate(), but lexes
+ * into a token array first so that lexing and validation are timed apart,
+ * and counts what went through both. scanql_validate() keeps no counters;
+ * a profile is only needed while statistics are wanted. A profile must not
+ * be used by two threads at once.
+ */
+typedef struct scanql_profile scanql_profile;
+
+/**
+ * struct scanql_stats - Counters of a validation profile
+ * @statements: statements validated
+ * @failed: statements with at least one error
+ * @bytes: bytes lexed
+ * @tokens: tokens lexed
+ * @tokens_by_type: tokens lexed per scanql_token_type
+ * @lex_ns: monotonic nanoseconds spent lexing
+ * @validate_ns: monotonic nanoseconds spent validating
+ * @errors_recorded: errors found, each statement up to its error limit
+ * @errors_stored: recorded errors that fit the error buffer
+ * @arena_used: most arena bytes one statement needed
+ * @arena_capacity: bytes the arena has grown to
+ */
+typedef struct scanql_stats
+{
+    uint64_t statements;
+    uint64_t failed;
+    uint64_t bytes;
+    uint64_t tokens;
+    uint64_t tokens_by_type[SCANQL_TOKEN_END];
+    uint64_t lex_ns;
+    uint64_t validate_ns;
+    uint64_t errors_recorded;
+    uint64_t errors_stored;
+    size_t arena_used;
+    size_t arena_capacity;
+} scanql_stats;
+
+/* Returns a new, zeroed profile, or NULL if out of memory. */
+SCANQL_API scanql_profile* scanql_profile_new(void);
+
+/* Releases a profile; NULL is ignored. */
+SCANQL_API void scanql_profile_free(scanql_profile* profile);
+
+/**
+ * scanql_validate_profiled - scanql_validate() with statistics
+ * @profile: profile to add the statement to
+ * @buf: SQL text
+ * @len: bytes in @buf
+ * @result: in: @result->error_limit; out: the verdict
+ *
+ * The result is the same as that of scanql_validate().
+ *
+ * Return: @result->ok.
+ */
+SCANQL_API bool scanql_validate_profiled(scanql_profile* profile,
+                                         const char* buf,
+                                         size_t len,
+                                         scanql_result* result);
+
+/* Copies the counters of @profile into @stats. */
+SCANQL_API void scanql_profile_stats(const scanql_profile* profile,
+                                     scanql_stats* stats);
+
+/**
+ * scanql_tokenize - Split a buffer into tokens
+ * @buf: SQL text
+ * @len: bytes in @buf
+ * @tokens: receives up to @capacity tokens (may be NULL if @capacity is 0)
+ * @capacity: entries available in @tokens
+ *
+ * Return: number of tokens in @buf, which may exceed @capacity.
+ */
+SCANQL_API size_t scanql_tokenize(const char* buf,
+                                  size_t len,
+                                  scanql_token* tokens,
+                                  size_t capacity);
+
+/**
+ * struct scanql_template - Literal-free form of a statement
+ * @id: template ID; equal for statements that only differ in literal
+ *      values, whitespace and keyword case
+ * @length: bytes of the normalized text without the NUL, which may exceed
+ *          the buffer it was written to
+ * @tokens: number of tokens
+ */
+typedef struct scanql_template
+{
+    uint64_t id;
+    size_t length;
+    size_t tokens;
+} scanql_template;
+
+/**
+ * scanql_normalize - Compute the template of a statement
+ * @buf: SQL text
+ * @len: bytes in @buf
+ * @out: receives the normalized text, NUL-terminated if @cap > 0 and
+ *       truncated to @cap - 1 bytes (may be NULL if @cap is 0)
+ * @cap: size of @out
+ * @tpl: receives the template ID and sizes
+ *
+ * The normalized text has every literal replaced by '?', keywords in upper
+ * case and tokens separated by single spaces, without spaces before ',',
+ * ';' and ')' or after '(': "SELECT a, b FROM t WHERE id = ?;". The ID is a
+ * 64-bit hash over the token types and the length and bytes of every
+ * identifier, computed in the same single lexing pass.
+ */
+SCANQL_API void scanql_normalize(const char* buf,
+                                 size_t len,
+                                 char* out,
+                                 size_t cap,
+                                 scanql_template* tpl);
+
+/**
+ * scanql_next_statement - Find the next statement of a multi-statement buffer
+ * @buf: SQL text
+ * @len: bytes in @buf
+ * @cursor: in/out read position; start with 0
+ * @stmt: receives the statement
+ *
+ * Statements end after a ';' outside of quotes. Leading whitespace and "--"
+ * comment lines are skipped.
+ *
+ * Return: true if a statement was found, false at the end of @buf.
+ */
+SCANQL_API bool scanql_next_statement(const char* buf,
+                                      size_t len,
+                                      size_t* cursor,
+                                      scanql_span* stmt);
+
+/**
+ * scanql_expected_str - Render an expected-token mask as "A | B | C"
+ * @expected: mask as in scanql_result.expected
+ * @buf: output buffer, always NUL-terminated if @n > 0
+ * @n: size of @buf
+ */
+SCANQL_API void scanql_expected_str(uint64_t expected, char* buf, size_t n);
+
+#define SCANQL_PRINT_COLOR (1u << 0) // highlight with ANSI escapes
+
+/**
+ * scanql_fprint_result - Print a human-readable verdict
+ * @out: stream to print to
+ * @buf: the SQL text that was validated, or NULL to omit the source line
+ * @len: bytes in @buf
+ * @result: verdict of scanql_validate() on @buf
+ * @flags: SCANQL_PRINT_* flags
+ *
+ * A failing verdict names the offending token and what was expected, then
+ * shows its line and column and the part of that line around the offending
+ * token, with a caret under it.
+ */
+SCANQL_API void scanql_fprint_result(FILE* out,
+                                     const char* buf,
+                                     size_t len,
+                                     const scanql_result* result,
+                                     unsigned flags);
+
+/**
+ * scanql_format_result - scanql_fprint_result() into a caller buffer
+ * @out: receives the report, NUL-terminated if @cap > 0 and truncated to
+ *       @cap - 1 bytes (may be NULL if @cap is 0)
+ * @cap: size of @out
+ * @buf: the SQL text that was validated, or NULL to omit the source line
+ * @len: bytes in @buf
+ * @result: verdict of scanql_validate() on @buf
+ * @flags: SCANQL_PRINT_* flags
+ *
+ * Return: bytes of the full report without the NUL, which may exceed @cap.
+ */
+SCANQL_API size_t scanql_format_result(char* out,
+                                       size_t cap,
+                                       const char* buf,
+                                       size_t len,
+                                       const scanql_result* result,
+                                       unsigned flags);
+
+/*
+ * Line index. Maps byte offsets of an input to line and column numbers for
+ * error reports. The input is only scanned for newlines when the first
+ * offset is looked up, so inputs without errors never pay for it; every
+ * lookup after that is a binary search. A line index may be shared by
+ * threads. The input must outlive it.
+ */
+typedef struct scanql_lines scanql_lines;
+
+/**
+ * struct scanql_position - Place of a byte in its input
+ * @line: 1-based line number
+ * @column: 1-based column, counted in bytes
+ */
+typedef struct scanql_position
+{
+    size_t line;
+    size_t column;
+} scanql_position;
+
+/* Returns an index of @buf that is not built yet, or NULL if out of memory. */
+SCANQL_API scanql_lines* scanql_lines_new(const char* buf, size_t len);
+
+/* Releases a line index; NULL is ignored. */
+SCANQL_API void scanql_lines_free(scanql_lines* lines);
+
+/**
+ * scanql_lines_locate - Line and column of a byte offset
+ * @lines: line index
+ * @offset: byte offset; clamped to the input length
+ * @pos: receives the position
+ *
+ * Return: false if the index could not be built for lack of memory.
+ */
+SCANQL_API bool
+scanql_lines_locate(scanql_lines* lines, size_t offset, scanql_position* pos);
+
+/**
+ * scanql_format_result_in - scanql_format_result() for a statement of a
+ * larger input
+ * @out: as for scanql_format_result()
+ * @cap: size of @out
+ * @lines: index of the whole input
+ * @stmt: the validated statement inside the input
+ * @result: verdict of scanql_validate() on @stmt
+ * @flags: SCANQL_PRINT_* flags
+ *
+ * The report locates the error by line and column of the whole input and
+ * shows only a window of the offending line, which may also hold other
+ * statements.
+ *
+ * Return: bytes of the full report without the NUL, which may exceed @cap.
+ */
+SCANQL_API size_t scanql_format_result_in(char* out,
+                                          size_t cap,
+                                          scanql_lines* lines,
+                                          scanql_span stmt,
+                                          const scanql_result* result,
+                                          unsigned flags);
+
+/*
+ * Push-style validation of a stream that arrives in chunks. Chunks may split
+ * the input anywhere; every statement is reported through the callback as
+ * soon as its ';' has been fed, and only a few bytes of lexer state are kept
+ * between chunks.
+ */
+typedef struct scanql_stream scanql_stream;
+
+/**
+ * struct scanql_statement - Verdict for one statement of a stream
+ * @index: 1-based statement number
+ * @span: stream offsets of the statement, from its first token to its end
+ * @result: verdict; @result.error.offset is a stream offset and its length
+ *          is 0, as the source bytes may be gone
+ */
+typedef struct scanql_statement
+{
+    size_t index;
+    scanql_span span;
+    scanql_result result;
+} scanql_statement;
+
+typedef void (*scanql_statement_fn)(const scanql_statement* stmt, void* user);
+
+/* Returns a new stream reporting to @fn, or NULL if out of memory. */
+SCANQL_API scanql_stream* scanql_stream_new(scanql_statement_fn fn, void* user);
+
+/* Feeds the next @len bytes of the stream. */
+SCANQL_API void
+scanql_stream_feed(scanql_stream* stream, const char* buf, size_t len);
+
+/* Ends the stream, reporting a trailing statement without ';'. */
+SCANQL_API void scanql_stream_finish(scanql_stream* stream);
+
+/* Releases a stream; NULL is ignored. */
+SCANQL_API void scanql_stream_free(scanql_stream* stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCANQL_H */
@@ -0,0 +1,839 @@
+#define _GNU_SOURCE // accept4
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "scanql.h"
+#include "serve.h"
+
+/*
+ * Protocol. A client sends any number of requests on a connection and gets
+ * one reply line per request, in request order. A request is either
+ *
+ *   <SQL>\n           a statement on a single line ("\r\n" is accepted), or
+ *   #<n>\n<n bytes>   a length-prefixed statement that may span lines.
+ *
+ * and the reply is one of
+ *
+ *   ok
+ *   fail <offset> <token> <expected>   e.g. "fail 13 END SQL_IDENTIFIER"
+ *   error <reason>                     the connection is closed after it
+ *
+ * <offset> is the byte offset of the offending token inside the request,
+ * <token> its type and <expected> the accepted types joined by '|' ("-" if
+ * there are none). Requests may be pipelined.
+ *
+ * The main thread runs an epoll loop that only accepts, reads, frames and
+ * writes. Every request becomes a ServeJob that a fixed pool of worker
+ * threads validates; finished jobs are handed back through an eventfd and
+ * their replies are written out in request order.
+ */
+#define SERVE_MAX_REQUEST (16u << 20)
+#define SERVE_MAX_PENDING 1024      // requests in flight per connection
+#define SERVE_MAX_OUTPUT (1u << 20) // unsent bytes before a reader pauses
+#define SERVE_READ_CHUNK (64 * 1024)
+#define SERVE_REPLY_MAX 1024
+#define SERVE_MAX_EVENTS 64
+
+typedef enum
+{
+    SERVE_LISTENER,
+    SERVE_WAKE,
+    SERVE_CONN,
+} ServeKind;
+
+/* Everything registered with epoll starts with a ServeSource */
+typedef struct
+{
+    ServeKind kind;
+    int fd;
+} ServeSource;
+
+typedef struct ServeConn ServeConn;
+
+/**
+ * struct ServeJob - One request and, once validated, its reply
+ * @conn: connection the reply goes to
+ * @next: next request of @conn, in request order
+ * @link: next job in the pool's todo or done list
+ * @done: @reply is final; only touched by the event loop
+ * @reply_len: bytes in @reply
+ * @reply: reply line including the '\n'
+ * @len: bytes in @sql
+ * @sql: copy of the request
+ */
+typedef struct ServeJob
+{
+    ServeConn* conn;
+    struct ServeJob* next;
+    struct ServeJob* link;
+    bool done;
+    size_t reply_len;
+    char reply[SERVE_REPLY_MAX];
+    size_t len;
+    char sql[];
+} ServeJob;
+
+/**
+ * struct ServeConn - State of one client connection
+ * @src: epoll source, kind SERVE_CONN
+ * @events: events currently registered with epoll
+ * @in: received bytes not yet framed into requests
+ * @out: reply bytes, @out_off of them already sent
+ * @first: oldest request still waiting for its reply
+ * @last: newest request
+ * @pending: requests from @first to @last
+ * @eof: no more requests will be read; close once all replies are sent
+ * @closed: the socket is gone; the struct lives until @pending drops to 0
+ * @dirty: queued for serve_update() after a round of finished jobs
+ * @dirty_next: next connection in that queue
+ * @prev: previous entry of Server.conns
+ * @next: next entry of Server.conns, or of Server.retired once retired
+ */
+struct ServeConn
+{
+    ServeSource src;
+    uint32_t events;
+    char* in;
+    size_t in_len;
+    size_t in_cap;
+    char* out;
+    size_t out_off;
+    size_t out_len;
+    size_t out_cap;
+    ServeJob* first;
+    ServeJob* last;
+    size_t pending;
+    bool eof;
+    bool closed;
+    bool dirty;
+    ServeConn* dirty_next;
+    ServeConn* prev;
+    ServeConn* next;
+};
+
+/**
+ * struct ServePool - Worker threads and the job lists they share
+ * @lock: protects everything below
+ * @ready: signalled when @todo gains jobs or @stop is set
+ * @todo: jobs to validate, oldest first
+ * @todo_last: last job of @todo
+ * @done: validated jobs, in no particular order
+ * @stop: the workers should exit
+ * @wake_fd: eventfd the loop waits on for @done to fill
+ */
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    ServeJob* todo;
+    ServeJob* todo_last;
+    ServeJob* done;
+    bool stop;
+    int wake_fd;
+} ServePool;
+
+typedef struct
+{
+    int epfd;
+    ServeSource listener;
+    ServeSource wake;
+    ServePool pool;
+    ServeConn* conns;
+    ServeConn* retired;
+} Server;
+
+static volatile sig_atomic_t serve_stop;
+
+static void serve_on_signal(int sig)
+{
+    (void)sig;
+    serve_stop = 1;
+}
+
+/* Append @s to the reply, always leaving room for the final '\n'. */
+static void reply_append(ServeJob* job, const char* s)
+{
+    size_t n    = strlen(s);
+    size_t room = sizeof(job->reply) - 1 - job->reply_len;
+    if (n > room)
+        n = room;
+    memcpy(job->reply + job->reply_len, s, n);
+    job->reply_len += n;
+}
+
+/* Validate a job's request and render its reply line. */
+static void serve_validate(ServeJob* job)
+{
+    scanql_result r = {.error_limit = 1};
+    job->reply_len  = 0;
+
+    if (scanql_validate(job->sql, job->len, &r))
+    {
+        reply_append(job, "ok\n");
+        return;
+    }
+
+    char head[64];
+    snprintf(head,
+             sizeof(head),
+             "fail %zu %s ",
+             r.error.offset,
+             scanql_token_name(r.error.type));
+    reply_append(job, head);
+
+    bool any = false;
+    for (int t = 0; t <= SCANQL_TOKEN_END; t++)
+    {
+        if (!(r.expected >> t & 1))
+            continue;
+        if (any)
+            reply_append(job, "|");
+        reply_append(job, scanql_token_name((scanql_token_type)t));
+        any = true;
+    }
+    if (!any)
+        reply_append(job, "-");
+    job->reply[job->reply_len++] = '\n';
+}
+
+static void* serve_worker(void* arg)
+{
+    ServePool* pool = arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->todo && !pool->stop)
+            pthread_cond_wait(&pool->ready, &pool->lock);
+        if (pool->stop)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        ServeJob* job = pool->todo;
+        pool->todo    = job->link;
+        if (!pool->todo)
+            pool->todo_last = NULL;
+        pthread_mutex_unlock(&pool->lock);
+
+        serve_validate(job);
+
+        /* Only the first job of a round has to wake the loop */
+        pthread_mutex_lock(&pool->lock);
+        bool wake  = pool->done == NULL;
+        job->link  = pool->done;
+        pool->done = job;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (wake)
+        {
+            uint64_t one = 1;
+            ssize_t n    = write(pool->wake_fd, &one, sizeof(one));
+            (void)n; // the counter cannot overflow with a reader this busy
+        }
+    }
+}
+
+/* Hand a chain of jobs linked through ServeJob.link to the workers. */
+static void
+serve_submit(ServePool* pool, ServeJob* first, ServeJob* last, size_t count)
+{
+    if (count == 0)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->todo_last)
+        pool->todo_last->link = first;
+    else
+        pool->todo = first;
+    pool->todo_last = last;
+    if (count > 1)
+        pthread_cond_broadcast(&pool->ready);
+    else
+        pthread_cond_signal(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Append a job to the connection's reply order. */
+static ServeJob* serve_job_new(ServeConn* c, const char* sql, size_t len)
+{
+    ServeJob* job = malloc(sizeof(*job) + len);
+    if (!job)
+        return NULL;
+
+    job->conn      = c;
+    job->next      = NULL;
+    job->link      = NULL;
+    job->done      = false;
+    job->reply_len = 0;
+    job->len       = len;
+    if (len)
+        memcpy(job->sql, sql, len);
+
+    if (c->last)
+        c->last->next = job;
+    else
+        c->first = job;
+    c->last = job;
+    c->pending++;
+    return job;
+}
+
+/* Close the socket; the struct itself waits for the jobs in flight. */
+static void serve_conn_close(Server* s, ServeConn* c)
+{
+    if (c->closed)
+        return;
+
+    epoll_ctl(s->epfd, EPOLL_CTL_DEL, c->src.fd, NULL);
+    close(c->src.fd);
+    c->closed = true;
+    c->eof    = true;
+    free(c->in);
+    free(c->out);
+    c->in      = NULL;
+    c->out     = NULL;
+    c->in_len  = c->in_cap = 0;
+    c->out_off = c->out_len = c->out_cap = 0;
+}
+
+/*
+ * Drop a closed connection that has no jobs in flight. Events for it may
+ * still be queued in the current epoll batch, so it is only freed by
+ * serve_reap() afterwards.
+ */
+static void serve_conn_retire(Server* s, ServeConn* c)
+{
+    serve_conn_close(s, c);
+    while (c->first)
+    {
+        ServeJob* job = c->first;
+        c->first      = job->next;
+        free(job);
+    }
+
+    if (c->prev)
+        c->prev->next = c->next;
+    else
+        s->conns = c->next;
+    if (c->next)
+        c->next->prev = c->prev;
+    c->next    = s->retired;
+    s->retired = c;
+}
+
+static void serve_reap(Server* s)
+{
+    while (s->retired)
+    {
+        ServeConn* c = s->retired;
+        s->retired   = c->next;
+        free(c);
+    }
+}
+
+static bool serve_conn_reading(const ServeConn* c)
+{
+    return !c->eof && c->pending < SERVE_MAX_PENDING &&
+           c->out_len - c->out_off < SERVE_MAX_OUTPUT;
+}
+
+static bool serve_queue_output(ServeConn* c, const char* buf, size_t len)
+{
+    if (c->out_off == c->out_len)
+        c->out_off = c->out_len = 0;
+
+    if (c->out_cap - c->out_len < len)
+    {
+        size_t cap = c->out_cap ? c->out_cap : 4096;
+        while (cap - c->out_len < len)
+            cap *= 2;
+        char* grown = realloc(c->out, cap);
+        if (!grown)
+            return false;
+        c->out     = grown;
+        c->out_cap = cap;
+    }
+
+    memcpy(c->out + c->out_len, buf, len);
+    c->out_len += len;
+    return true;
+}
+
+typedef enum
+{
+    SERVE_FRAME_INCOMPLETE,
+    SERVE_FRAME_READY,
+    SERVE_FRAME_MALFORMED,
+    SERVE_FRAME_TOO_LARGE,
+} ServeFrame;
+
+/**
+ * serve_next_frame - Find the first request in a connection's input
+ * @buf: received bytes
+ * @len: bytes in @buf
+ * @eof: no more bytes will arrive; a final line needs no '\n'
+ * @sql: receives the request inside @buf
+ * @frame_len: receives the bytes to consume, framing included
+ */
+static ServeFrame serve_next_frame(const char* buf,
+                                   size_t len,
+                                   bool eof,
+                                   scanql_span* sql,
+                                   size_t* frame_len)
+{
+    if (len == 0)
+        return SERVE_FRAME_INCOMPLETE;
+
+    if (buf[0] == '#')
+    {
+        size_t i = 1;
+        size_t n = 0;
+        for (; i < len && buf[i] >= '0' && buf[i] <= '9'; i++)
+        {
+            if (n > SERVE_MAX_REQUEST)
+                return SERVE_FRAME_TOO_LARGE;
+            n = n * 10 + (size_t)(buf[i] - '0');
+        }
+        if (i == len)
+            return eof ? SERVE_FRAME_MALFORMED : SERVE_FRAME_INCOMPLETE;
+        if (i == 1 || buf[i] != '\n')
+            return SERVE_FRAME_MALFORMED;
+        if (n > SERVE_MAX_REQUEST)
+            return SERVE_FRAME_TOO_LARGE;
+        if (len - i - 1 < n)
+            return eof ? SERVE_FRAME_MALFORMED : SERVE_FRAME_INCOMPLETE;
+
+        *sql       = (scanql_span){.offset = i + 1, .length = n};
+        *frame_len = i + 1 + n;
+        return SERVE_FRAME_READY;
+    }
+
+    const char* nl = memchr(buf, '\n', len);
+    size_t line    = nl ? (size_t)(nl - buf) : len;
+    if (line > SERVE_MAX_REQUEST)
+        return SERVE_FRAME_TOO_LARGE;
+    if (!nl && !eof)
+        return SERVE_FRAME_INCOMPLETE;
+
+    *sql       = (scanql_span){.offset = 0, .length = line};
+    *frame_len = nl ? line + 1 : line;
+    if (line && buf[line - 1] == '\r')
+        sql->length--;
+    return SERVE_FRAME_READY;
+}
+
+/*
+ * Turn buffered input into jobs while the connection may have more requests
+ * in flight. A framing error queues an "error" reply behind the pending ones
+ * and stops reading.
+ */
+static void serve_parse(Server* s, ServeConn* c)
+{
+    ServeJob* first = NULL;
+    ServeJob* last  = NULL;
+    size_t count    = 0;
+    size_t off      = 0;
+
+    while (c->pending < SERVE_MAX_PENDING)
+    {
+        scanql_span sql;
+        size_t frame_len;
+        ServeFrame frame = serve_next_frame(
+            c->in + off, c->in_len - off, c->eof, &sql, &frame_len);
+        if (frame == SERVE_FRAME_INCOMPLETE)
+            break;
+
+        if (frame != SERVE_FRAME_READY)
+        {
+            ServeJob* job = serve_job_new(c, NULL, 0);
+            if (job)
+            {
+                job->done = true;
+                reply_append(job,
+                             frame == SERVE_FRAME_TOO_LARGE
+                                 ? "error request too large"
+                                 : "error malformed length prefix");
+                job->reply[job->reply_len++] = '\n';
+            }
+            c->eof = true;
+            off    = c->in_len;
+            break;
+        }
+
+        ServeJob* job = serve_job_new(c, c->in + off + sql.offset, sql.length);
+        if (!job)
+        {
+            serve_conn_close(s, c);
+            break;
+        }
+        if (last)
+            last->link = job;
+        else
+            first = job;
+        last = job;
+        count++;
+        off += frame_len;
+    }
+
+    if (!c->closed && off)
+    {
+        memmove(c->in, c->in + off, c->in_len - off);
+        c->in_len -= off;
+    }
+    serve_submit(&s->pool, first, last, count);
+}
+
+/* Move the finished replies at the front of the reply order to the output. */
+static void serve_collect(Server* s, ServeConn* c)
+{
+    while (c->first && c->first->done)
+    {
+        ServeJob* job = c->first;
+        if (!c->closed && !serve_queue_output(c, job->reply, job->reply_len))
+            serve_conn_close(s, c);
+
+        c->first = job->next;
+        if (!c->first)
+            c->last = NULL;
+        c->pending--;
+        free(job);
+    }
+}
+
+/*
+ * Bring a connection up to date: collect replies, frame more requests, send
+ * what can be sent, then close it or adjust the events it waits for.
+ */
+static void serve_update(Server* s, ServeConn* c)
+{
+    serve_collect(s, c);
+    if (!c->closed)
+    {
+        serve_parse(s, c);
+        serve_collect(s, c);
+    }
+
+    while (!c->closed && c->out_off < c->out_len)
+    {
+        ssize_t n = send(c->src.fd,
+                         c->out + c->out_off,
+                         c->out_len - c->out_off,
+                         MSG_NOSIGNAL);
+        if (n >= 0)
+            c->out_off += (size_t)n;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+        else if (errno != EINTR)
+            serve_conn_close(s, c);
+    }
+
+    if (c->closed)
+    {
+        if (c->pending == 0)
+            serve_conn_retire(s, c);
+        return;
+    }
+
+    bool flushed = c->out_off == c->out_len;
+    if (c->eof && c->pending == 0 && flushed)
+    {
+        serve_conn_retire(s, c);
+        return;
+    }
+
+    uint32_t events =
+        (serve_conn_reading(c) ? EPOLLIN : 0) | (flushed ? 0 : EPOLLOUT);
+    if (events != c->events)
+    {
+        struct epoll_event ev = {.events = events, .data.ptr = &c->src};
+        epoll_ctl(s->epfd, EPOLL_CTL_MOD, c->src.fd, &ev);
+        c->events = events;
+    }
+}
+
+/* Read one chunk; level-triggered epoll reports the rest. */
+static void serve_read(Server* s, ServeConn* c)
+{
+    if (c->in_cap - c->in_len < SERVE_READ_CHUNK)
+    {
+        size_t cap = c->in_cap ? c->in_cap * 2 : SERVE_READ_CHUNK;
+        while (cap - c->in_len < SERVE_READ_CHUNK)
+            cap *= 2;
+        char* grown = realloc(c->in, cap);
+        if (!grown)
+        {
+            serve_conn_close(s, c);
+            return;
+        }
+        c->in     = grown;
+        c->in_cap = cap;
+    }
+
+    ssize_t n = read(c->src.fd, c->in + c->in_len, SERVE_READ_CHUNK);
+    if (n > 0)
+        c->in_len += (size_t)n;
+    else if (n == 0)
+        c->eof = true;
+    else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        serve_conn_close(s, c);
+}
+
+static void serve_accept(Server* s)
+{
+    for (;;)
+    {
+        int fd = accept4(
+            s->listener.fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        ServeConn* c = calloc(1, sizeof(*c));
+        if (!c)
+        {
+            close(fd);
+            continue;
+        }
+        c->src    = (ServeSource){.kind = SERVE_CONN, .fd = fd};
+        c->events = EPOLLIN;
+
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &c->src};
+        if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            close(fd);
+            free(c);
+            continue;
+        }
+
+        c->next = s->conns;
+        if (s->conns)
+            s->conns->prev = c;
+        s->conns = c;
+    }
+}
+
+/* Pick up the jobs the workers finished and update their connections. */
+static void serve_finished(Server* s)
+{
+    uint64_t count;
+    ssize_t n = read(s->wake.fd, &count, sizeof(count));
+    (void)n;
+
+    pthread_mutex_lock(&s->pool.lock);
+    ServeJob* done = s->pool.done;
+    s->pool.done   = NULL;
+    pthread_mutex_unlock(&s->pool.lock);
+
+    ServeConn* dirty = NULL;
+    for (ServeJob* job = done; job; job = job->link)
+    {
+        job->done = true;
+        if (!job->conn->dirty)
+        {
+            job->conn->dirty      = true;
+            job->conn->dirty_next = dirty;
+            dirty                 = job->conn;
+        }
+    }
+
+    while (dirty)
+    {
+        ServeConn* c = dirty;
+        dirty        = c->dirty_next;
+        c->dirty     = false;
+        serve_update(s, c);
+    }
+}
+
+/* True if @addr names a socket file nobody is listening on. */
+static bool serve_socket_is_stale(const struct sockaddr_un* addr)
+{
+    struct stat st;
+    if (lstat(addr->sun_path, &st) != 0 || !S_ISSOCK(st.st_mode))
+        return false;
+
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0)
+        return false;
+    int rc     = connect(probe, (const struct sockaddr*)addr, sizeof(*addr));
+    bool stale = rc != 0 && errno == ECONNREFUSED;
+    close(probe);
+    return stale;
+}
+
+static int serve_listen(const char* path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return -1;
+    }
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+
+    int rc = bind(fd, (const struct sockaddr*)&addr, sizeof(addr));
+    if (rc != 0 && errno == EADDRINUSE && serve_socket_is_stale(&addr))
+    {
+        unlink(path);
+        rc = bind(fd, (const struct sockaddr*)&addr, sizeof(addr));
+    }
+    if (rc != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int run_serve(const char* path, size_t jobs)
+{
+    Server s = {
+        .epfd     = -1,
+        .listener = {.kind = SERVE_LISTENER, .fd = -1},
+        .wake     = {.kind = SERVE_WAKE, .fd = -1},
+    };
+
+    /* SIGINT and SIGTERM are only delivered inside epoll_pwait() */
+    sigset_t stop_signals;
+    sigset_t orig_mask;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &orig_mask);
+
+    struct sigaction sa = {.sa_handler = serve_on_signal};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    s.listener.fd = serve_listen(path);
+    if (s.listener.fd < 0)
+        return 2;
+
+    s.epfd    = epoll_create1(EPOLL_CLOEXEC);
+    s.wake.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event lev = {.events = EPOLLIN, .data.ptr = &s.listener};
+    struct epoll_event wev = {.events = EPOLLIN, .data.ptr = &s.wake};
+    if (s.epfd < 0 || s.wake.fd < 0 ||
+        epoll_ctl(s.epfd, EPOLL_CTL_ADD, s.listener.fd, &lev) != 0 ||
+        epoll_ctl(s.epfd, EPOLL_CTL_ADD, s.wake.fd, &wev) != 0)
+    {
+        perror("epoll");
+        if (s.wake.fd >= 0)
+            close(s.wake.fd);
+        if (s.epfd >= 0)
+            close(s.epfd);
+        close(s.listener.fd);
+        unlink(path);
+        return 2;
+    }
+
+    pthread_mutex_init(&s.pool.lock, NULL);
+    pthread_cond_init(&s.pool.ready, NULL);
+    s.pool.wake_fd = s.wake.fd;
+
+    pthread_t* threads = calloc(jobs, sizeof(pthread_t));
+    size_t started     = 0;
+    while (threads && started < jobs &&
+           pthread_create(&threads[started], NULL, serve_worker, &s.pool) == 0)
+        started++;
+
+    int rc = 0;
+    if (started == 0)
+    {
+        fprintf(stderr, "%s: could not start worker threads\n", path);
+        rc = 2;
+    }
+    else
+    {
+        fprintf(stderr,
+                "scanql: serving on %s with %zu workers\n",
+                path,
+                started);
+    }
+
+    struct epoll_event events[SERVE_MAX_EVENTS];
+    while (rc == 0 && !serve_stop)
+    {
+        int n = epoll_pwait(s.epfd, events, SERVE_MAX_EVENTS, -1, &orig_mask);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_pwait");
+            rc = 2;
+            break;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            ServeSource* src = events[i].data.ptr;
+            if (src->kind == SERVE_LISTENER)
+                serve_accept(&s);
+            else if (src->kind == SERVE_WAKE)
+                serve_finished(&s);
+            else
+            {
+                /* src is the first member of its connection */
+                ServeConn* c = (ServeConn*)src;
+                if (c->closed)
+                    continue;
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                    serve_conn_close(&s, c);
+                else if (events[i].events & EPOLLIN)
+                    serve_read(&s, c);
+                serve_update(&s, c);
+            }
+        }
+        serve_reap(&s);
+    }
+
+    pthread_mutex_lock(&s.pool.lock);
+    s.pool.stop = true;
+    pthread_cond_broadcast(&s.pool.ready);
+    pthread_mutex_unlock(&s.pool.lock);
+    for (size_t w = 0; w < started; w++)
+        pthread_join(threads[w], NULL);
+    free(threads);
+
+    /* Every job is owned by its connection's reply order */
+    while (s.conns)
+        serve_conn_retire(&s, s.conns);
+    serve_reap(&s);
+
+    pthread_cond_destroy(&s.pool.ready);
+    pthread_mutex_destroy(&s.pool.lock);
+    close(s.wake.fd);
+    close(s.epfd);
+    close(s.listener.fd);
+    unlink(path);
+    pthread_sigmask(SIG_SETMASK, &orig_mask, NULL);
+    return rc;
+}
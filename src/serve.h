@@ -0,0 +1,20 @@
+/*
+ * serve.h - Validation daemon of the scanql command line tool
+ */
+#ifndef SCANQL_SERVE_H
+#define SCANQL_SERVE_H
+
+#include <stddef.h>
+
+/**
+ * run_serve - Serve validation requests on a Unix domain socket
+ * @path: filesystem path of the socket; a stale socket file is replaced
+ * @jobs: number of worker threads validating requests
+ *
+ * Runs until SIGINT or SIGTERM, then removes the socket file.
+ *
+ * Return: 0 after a clean shutdown, 2 if the server could not be set up.
+ */
+int run_serve(const char* path, size_t jobs);
+
+#endif /* SCANQL_SERVE_H */